@@ -1,271 +1,6363 @@
 #include <iostream>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <unordered_map>
+#include <memory>
 #include <functional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <barrier>
+#include <latch>
+#include <new>
+#include <bit>
+#include <limits>
+#include <coroutine>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+// Benchmark builds (-DTQ_COUNT_ALLOCATIONS) replace the global allocation
+// functions to count every heap allocation, so benchmarks can report
+// allocations per operation. Other builds keep the standard allocator and
+// report the counts as null.
+#ifdef TQ_COUNT_ALLOCATIONS
+constexpr bool kCountAllocations = true;
+#else
+constexpr bool kCountAllocations = false;
+#endif
+
+std::atomic<std::size_t> heapAllocations{ 0 };
+
+// Allocations per operation for benchmark JSON.
+struct AllocationRate {
+    std::size_t allocations;
+    double ops;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const AllocationRate& rate) {
+    if (!kCountAllocations) return out << "null";
+    return out << (rate.ops > 0 ? static_cast<double>(rate.allocations) / rate.ops : 0.0);
+}
+
+#ifdef TQ_COUNT_ALLOCATIONS
+// The array forms forward to these in libstdc++. new and delete are kept out
+// of line so GCC does not flag an inlined free() as mismatched with an
+// inlined malloc().
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, std::align_val_t alignment) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (void* p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) & ~(align - 1))) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    return std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) & ~(align - 1));
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+#endif
 
 enum class CallType { NORMAL, EMERGENCY };
 
+// Handle to a string interned in a queue's CallerArena; 0 is the empty string.
+using StringHandle = std::uint32_t;
+
+// Who is calling, as handles into the CallerArena of the queue holding the
+// call. The arena reads handles only when `epoch` matches one of its own.
+struct CallerInfo {
+    StringHandle number;   // caller's phone number
+    StringHandle language; // preferred language
+    StringHandle account;  // billing account
+    std::uint32_t epoch;   // arena generation that issued the handles, 0 for none
+};
+
 struct Call {
     int callId;
     CallType type;
     int duration; // duration in minutes
     bool callbackRequested;
+    std::int64_t enqueuedAtNs = 0; // set by enqueue while a WaitTimeRecorder is attached
+    std::int64_t deadlineNs = 0;   // SLA answer-by time on the nowNanos() clock, 0 for none
+    CallerInfo caller{};           // set by the enqueue overload taking caller metadata
 };
 
-class CircularQueue {
-private:
-    std::vector<Call> queue;
-    int front, rear, capacity;
+// Calls are copied with memcpy into logs, rings and replication batches.
+static_assert(std::is_trivially_copyable_v<Call>);
+
+// Monotonic clock in nanoseconds. CLOCK_MONOTONIC is shared by all processes
+// on the host, so timestamps taken in different processes are comparable.
+inline std::int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
+// Operations that change the queue, in the order they are applied.
+// CANCEL removes the first call with the given id, REMOVE_NEWEST the call at
+// the back; replaying either reproduces exactly the call the queue removed.
+enum class QueueOp : std::uint8_t { ENQUEUE = 1, DEQUEUE = 2, PRIORITIZE = 3, CHECKPOINT = 4, CANCEL = 5, REMOVE_NEWEST = 6 };
+
+// Receives every successful mutation of a CircularQueue. The call is the one
+// enqueued, dequeued or removed, and nullptr for PRIORITIZE.
+class QueueJournal {
 public:
-    CircularQueue(int size) : capacity(size), front(-1), rear(-1) {
-        queue.resize(capacity);
+    virtual ~QueueJournal() = default;
+    virtual void record(QueueOp op, const Call* call) = 0;
+
+    // True once the journal can no longer record; the queue then refuses new
+    // calls rather than accept ones it cannot make durable.
+    virtual bool failed() const { return false; }
+};
+
+// Snapshot of an HDR-style histogram: log-linear buckets that record any
+// 64-bit value with a relative error below 1/128 (2^-kSubBucketBits) in a
+// fixed number of counters.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 7;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    // Values below kSubBuckets get a counter each. Above that, every power of
+    // two is split into kSubBuckets equal counters.
+    static int bucketIndex(std::int64_t value) {
+        if (value < kSubBuckets) return value < 0 ? 0 : static_cast<int>(value);
+        int msb = 63 - __builtin_clzll(static_cast<std::uint64_t>(value));
+        int shift = msb - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + static_cast<int>((value >> shift) - kSubBuckets);
     }
 
-    bool isFull() {
-        return ((rear + 1) % capacity == front);
+    // Largest value that falls into bucket `index`.
+    static std::int64_t highestEquivalentValue(int index) {
+        int range = index / kSubBuckets;
+        if (range == 0) return index;
+        int shift = range - 1;
+        std::int64_t low = static_cast<std::int64_t>(kSubBuckets + index % kSubBuckets) << shift;
+        return low + ((std::int64_t(1) << shift) - 1);
     }
 
-    bool isEmpty() {
-        return (front == -1);
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(kBucketCount);
+
+    std::uint64_t count() const {
+        std::uint64_t total = 0;
+        for (std::uint64_t c : counts) total += c;
+        return total;
     }
 
-    void enqueue(const Call& call) {
-        if (isFull()) {
-            std::cout << "Queue Overflow! Cannot enqueue call.\n";
-            return;
+    // Value at quantile `q` in [0, 1], e.g. 0.999 for p99.9; 0 when empty.
+    std::int64_t percentile(double q) const {
+        std::uint64_t total = count();
+        if (total == 0) return 0;
+        std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * total));
+        if (rank == 0) rank = 1;
+        std::uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return highestEquivalentValue(i);
         }
-        if (front == -1) front = 0;
-        rear = (rear + 1) % capacity;
-        queue[rear] = call;
-        std::cout << "Enqueued Call ID: " << call.callId << "\n";
+        return max();
     }
 
-    void dequeue() {
-        if (isEmpty()) {
-            std::cout << "Queue Underflow! Cannot dequeue call.\n";
-            return;
-        }
-        std::cout << "Dequeued Call ID: " << queue[front].callId << "\n";
-        if (front == rear) {
-            front = rear = -1; // Reset queue
-        }
-        else {
-            front = (front + 1) % capacity;
+    std::int64_t max() const {
+        for (int i = kBucketCount - 1; i >= 0; --i) {
+            if (counts[i]) return highestEquivalentValue(i);
         }
+        return 0;
     }
+};
 
-    void display() {
-        if (isEmpty()) {
-            std::cout << "Queue is empty.\n";
-            return;
-        }
-        int index = front;
-        do {
-            std::cout << "Call ID: " << queue[index].callId
-                << ", Type: " << (queue[index].type == CallType::NORMAL ? "NORMAL" : "EMERGENCY")
-                << ", Duration: " << queue[index].duration
-                << ", Callback Requested: " << (queue[index].callbackRequested ? "Yes" : "No")
-                << "\n";
-            index = (index + 1) % capacity;
-        } while (index != (rear + 1) % capacity);
+// One T per thread that touches it, all owned by this object.
+//
+// A thread's instance is created on first use and pushed onto a lock-free
+// list, then found again through a thread_local cache, so local() costs a
+// compare and a load in the common case. Instances live until the owner is
+// destroyed (counts recorded by exited threads are kept), and readers walk
+// them with forEach() while their threads keep writing. Each instance is
+// cache-line aligned so threads never share a line.
+//
+// A thread's cache would otherwise keep an entry for every owner it ever
+// touched. On a miss, if owners have been destroyed since the thread last
+// looked, it drops their entries, so the cache only holds live owners.
+template <typename T>
+class PerThreadSlots {
+private:
+    struct alignas(64) Node {
+        T value{};
+        Node* next = nullptr;
+    };
+
+    struct CacheEntry {
+        std::uint64_t ownerId;
+        Node* node;
+    };
+
+    // Ids of the owners not yet destroyed, ascending. Never freed, since
+    // threads may still look it up during static destruction.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::uint64_t> liveOwners;
+        std::atomic<std::uint64_t> destroyed{ 0 };
+    };
+
+    static Registry& registry() {
+        static Registry* instance = new Registry();
+        return *instance;
     }
 
-    void prioritizeEmergencyCalls() {
-        if (isEmpty()) return;
+    static inline std::atomic<std::uint64_t> nextOwnerId{ 0 };
+    static inline thread_local CacheEntry last = { 0, nullptr };
+    static inline thread_local std::vector<CacheEntry> cache;
+    static inline thread_local std::uint64_t destroyedSeen = 0;
 
-        std::vector<Call> tempQueue;
+    std::uint64_t id = nextOwnerId.fetch_add(1) + 1;
+    std::atomic<Node*> head{ nullptr };
 
-        // Collect emergency calls first
-        for (int index = front; index <= rear; ++index) {
-            if (queue[index].type == CallType::EMERGENCY) {
-                tempQueue.push_back(queue[index]);
-            }
+    Node* registerThread() {
+        Node* node = new Node();
+        Node* expected = head.load(std::memory_order_relaxed);
+        do {
+            node->next = expected;
+        } while (!head.compare_exchange_weak(expected, node, std::memory_order_release, std::memory_order_relaxed));
+        return node;
+    }
+
+public:
+    PerThreadSlots() {
+        Registry& owners = registry();
+        std::lock_guard<std::mutex> lock(owners.mutex);
+        owners.liveOwners.insert(std::upper_bound(owners.liveOwners.begin(), owners.liveOwners.end(), id), id);
+    }
+
+    ~PerThreadSlots() {
+        Registry& owners = registry();
+        {
+            std::lock_guard<std::mutex> lock(owners.mutex);
+            owners.liveOwners.erase(std::lower_bound(owners.liveOwners.begin(), owners.liveOwners.end(), id));
+        }
+        owners.destroyed.fetch_add(1, std::memory_order_release);
+        for (Node* node = head.load(); node;) {
+            Node* next = node->next;
+            delete node;
+            node = next;
         }
+    }
 
-        // Then, collect normal calls
-        for (int index = front; index <= rear; ++index) {
-            if (queue[index].type == CallType::NORMAL) {
-                tempQueue.push_back(queue[index]);
+    PerThreadSlots(const PerThreadSlots&) = delete;
+    PerThreadSlots& operator=(const PerThreadSlots&) = delete;
+
+    T& local() {
+        if (last.ownerId == id) return last.node->value;
+        for (const CacheEntry& cached : cache) {
+            if (cached.ownerId == id) {
+                last = cached;
+                return last.node->value;
             }
         }
-
-        // Rebuild the queue with emergency calls first
-        for (int index = 0; index < tempQueue.size(); ++index) {
-            queue[index] = tempQueue[index];
+        Registry& owners = registry();
+        if (std::uint64_t destroyed = owners.destroyed.load(std::memory_order_acquire); destroyed != destroyedSeen) {
+            std::lock_guard<std::mutex> lock(owners.mutex);
+            std::erase_if(cache, [&](const CacheEntry& cached) {
+                return !std::binary_search(owners.liveOwners.begin(), owners.liveOwners.end(), cached.ownerId);
+            });
+            destroyedSeen = destroyed;
         }
+        last = { id, registerThread() };
+        cache.push_back(last);
+        return last.node->value;
+    }
 
-        front = 0;
-        rear = tempQueue.size() - 1;
+    // Owners of this type the calling thread currently has cached.
+    static std::size_t cachedOwners() { return cache.size(); }
+
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (Node* node = head.load(std::memory_order_acquire); node; node = node->next) visit(node->value);
     }
 };
 
-int main() {
+// Adds to a counter that only the calling thread writes: a relaxed load and
+// store, no read-modify-write, since no other thread can race the update.
+inline void bumpOwnCounter(std::atomic<std::uint64_t>& counter, std::uint64_t delta = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
 
-    {
-        CircularQueue cq(5);  std::cout << "\n\n";
+// Records how long calls waited in a queue, per CallType, from any number of
+// threads.
+//
+// Each recording thread has its own counters (see PerThreadSlots), so
+// recording never contends or does an atomic read-modify-write. snapshot()
+// merges all threads' counters without stopping them. intervalSnapshot()
+// returns what was recorded since the previous interval, by subtracting the
+// counts it last returned, so intervals can be reset while traffic keeps
+// flowing.
+class WaitTimeRecorder {
+private:
+    struct ThreadCounters {
+        std::atomic<std::uint64_t> counts[2][LatencyHistogram::kBucketCount];
+    };
 
-        Call call1 = { 1, CallType::NORMAL, 10, false };
-        Call call2 = { 2, CallType::EMERGENCY, 5, true };
-        Call call3 = { 3, CallType::NORMAL, 15, false };
-        Call call4 = { 4, CallType::EMERGENCY, 8, true };
-        Call call5 = { 5, CallType::NORMAL, 20, false };
+    PerThreadSlots<ThreadCounters> threads;
+    LatencyHistogram intervalStart[2];
 
-        cq.enqueue(call1);
-        cq.enqueue(call2);
-        cq.enqueue(call3);
-        cq.enqueue(call4);
-        cq.enqueue(call5);
+public:
+    void record(CallType type, std::int64_t waitNs) {
+        bumpOwnCounter(threads.local().counts[static_cast<int>(type)][LatencyHistogram::bucketIndex(waitNs)]);
+    }
 
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
+    // Everything recorded so far for `type`, merged across threads.
+    LatencyHistogram snapshot(CallType type) const {
+        LatencyHistogram merged;
+        threads.forEach([&](const ThreadCounters& counters) {
+            const auto& counts = counters.counts[static_cast<int>(type)];
+            for (int i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+                merged.counts[i] += counts[i].load(std::memory_order_relaxed);
+            }
+        });
+        return merged;
+    }
 
-        cq.prioritizeEmergencyCalls();
+    // What was recorded for `type` since the previous call for that type.
+    // Intervals are meant to be read from a single reporting thread.
+    LatencyHistogram intervalSnapshot(CallType type) {
+        LatencyHistogram total = snapshot(type);
+        LatencyHistogram& start = intervalStart[static_cast<int>(type)];
+        LatencyHistogram interval;
+        for (int i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+            interval.counts[i] = total.counts[i] - start.counts[i];
+        }
+        start = total;
+        return interval;
+    }
+};
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+// Health metrics for CircularQueues: counters per thread, aggregated when
+// read, and exported as Prometheus text.
+//
+// Counters live in PerThreadSlots, so the enqueue/dequeue fast path adds a
+// relaxed load/store to a cache line only its own thread writes. Depth per
+// CallType is derived on read from the counters, plus the depth queues
+// already had when the metrics were attached. The high-water mark is a
+// shared atomic that is only written when a queue exceeds it. Several queues
+// may share one QueueMetrics: counters and depth are then summed over them,
+// and the high-water mark is the deepest any one of them has been.
+class QueueMetrics {
+public:
+    enum Counter { ENQUEUES, DEQUEUES, OVERFLOWS, CANCELLATIONS, kPerTypeCounters };
 
-        cq.dequeue();
-        cq.dequeue();
+private:
+    struct ThreadCounters {
+        std::atomic<std::uint64_t> byType[kPerTypeCounters][2];
+        std::atomic<std::uint64_t> underflows;
+        std::atomic<std::uint64_t> reprioritizations;
+    };
+
+    PerThreadSlots<ThreadCounters> threads;
+    std::string queueName;
+    std::atomic<std::int64_t> depthBaseline[2] = {};
+    std::atomic<std::int64_t> highWater[2] = {};
+
+    template <typename Read>
+    std::uint64_t sum(Read read) const {
+        std::uint64_t total = 0;
+        threads.forEach([&](const ThreadCounters& counters) { total += read(counters).load(std::memory_order_relaxed); });
+        return total;
+    }
 
-        std::cout << "Queue after two dequeues:\n";
-        cq.display();  std::cout << "\n\n";
+public:
+    explicit QueueMetrics(const std::string& name = "default") : queueName(name) {}
+
+    void count(Counter counter, CallType type) {
+        bumpOwnCounter(threads.local().byType[counter][static_cast<int>(type)]);
     }
 
+    void countUnderflow() { bumpOwnCounter(threads.local().underflows); }
+    void countReprioritization() { bumpOwnCounter(threads.local().reprioritizations); }
 
+    void observeDepth(CallType type, std::int64_t depth) {
+        std::atomic<std::int64_t>& mark = highWater[static_cast<int>(type)];
+        std::int64_t seen = mark.load(std::memory_order_relaxed);
+        while (depth > seen && !mark.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {}
+    }
 
-    // Happy Path Test Case 2
+    // Accounts for calls a queue held before the metrics were attached to it
+    // (positive) or still holds when they are detached (negative).
+    void adjustDepth(CallType type, std::int64_t delta) {
+        depthBaseline[static_cast<int>(type)].fetch_add(delta, std::memory_order_relaxed);
+        if (delta > 0) observeDepth(type, delta);
+    }
 
-    {
-        CircularQueue cq(4);
+    std::uint64_t total(Counter counter, CallType type) const {
+        return sum([&](const ThreadCounters& c) -> const std::atomic<std::uint64_t>& {
+            return c.byType[counter][static_cast<int>(type)];
+        });
+    }
 
-        Call call1 = { 1, CallType::NORMAL, 10, false };
-        Call call2 = { 2, CallType::EMERGENCY, 5, true };
-        Call call3 = { 3, CallType::NORMAL, 15, false };
-        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+    std::uint64_t underflows() const {
+        return sum([](const ThreadCounters& c) -> const std::atomic<std::uint64_t>& { return c.underflows; });
+    }
 
-        cq.enqueue(call1);
-        cq.enqueue(call2);
-        cq.enqueue(call3);
-        cq.enqueue(call4);
+    std::uint64_t reprioritizations() const {
+        return sum([](const ThreadCounters& c) -> const std::atomic<std::uint64_t>& { return c.reprioritizations; });
+    }
 
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
+    std::int64_t depth(CallType type) const {
+        return depthBaseline[static_cast<int>(type)].load(std::memory_order_relaxed)
+            + static_cast<std::int64_t>(total(ENQUEUES, type) - total(DEQUEUES, type) - total(CANCELLATIONS, type));
+    }
 
-        cq.prioritizeEmergencyCalls();
+    std::int64_t highWaterMark(CallType type) const {
+        return highWater[static_cast<int>(type)].load(std::memory_order_relaxed);
+    }
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+    // Snapshot in the Prometheus text exposition format.
+    std::string prometheusText() const {
+        std::string out;
+        auto family = [&](const char* name, const char* kind, const char* help) {
+            out += std::string("# HELP telephone_queue_") + name + " " + help + "\n";
+            out += std::string("# TYPE telephone_queue_") + name + " " + kind + "\n";
+        };
+        auto sample = [&](const char* name, const char* type, std::int64_t value) {
+            out += std::string("telephone_queue_") + name + "{queue=\"" + queueName + "\"";
+            if (type) out += std::string(",type=\"") + type + "\"";
+            out += "} " + std::to_string(value) + "\n";
+        };
+        auto perType = [&](const char* name, auto value) {
+            sample(name, "normal", value(CallType::NORMAL));
+            sample(name, "emergency", value(CallType::EMERGENCY));
+        };
+
+        family("enqueues_total", "counter", "Calls accepted into the queue.");
+        perType("enqueues_total", [&](CallType t) { return static_cast<std::int64_t>(total(ENQUEUES, t)); });
+        family("dequeues_total", "counter", "Calls taken from the queue.");
+        perType("dequeues_total", [&](CallType t) { return static_cast<std::int64_t>(total(DEQUEUES, t)); });
+        family("overflows_total", "counter", "Calls rejected because the queue was full.");
+        perType("overflows_total", [&](CallType t) { return static_cast<std::int64_t>(total(OVERFLOWS, t)); });
+        family("cancellations_total", "counter", "Calls removed before being answered.");
+        perType("cancellations_total", [&](CallType t) { return static_cast<std::int64_t>(total(CANCELLATIONS, t)); });
+        family("underflows_total", "counter", "Dequeues attempted on an empty queue.");
+        sample("underflows_total", nullptr, static_cast<std::int64_t>(underflows()));
+        family("reprioritizations_total", "counter", "Times emergency calls were moved to the front.");
+        sample("reprioritizations_total", nullptr, static_cast<std::int64_t>(reprioritizations()));
+        family("depth", "gauge", "Calls currently waiting.");
+        perType("depth", [&](CallType t) { return depth(t); });
+        family("depth_high_water", "gauge", "Most calls of a type that have waited at once.");
+        perType("depth_high_water", [&](CallType t) { return highWaterMark(t); });
+        return out;
+    }
+};
 
-        cq.dequeue();
-        cq.dequeue();
+// Cycle counter used for trace timestamps; falls back to the monotonic clock
+// where there is no TSC.
+inline std::uint64_t readTimestampCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(nowNanos());
+#endif
+}
 
-        std::cout << "Queue after two dequeues:\n";
-        cq.display();  std::cout << "\n\n";
+enum class LifecycleStage : std::uint8_t { ENQUEUED, REJECTED, REPRIORITIZED, DEQUEUED, CANCELLED };
 
+struct LifecycleEvent {
+    std::uint64_t timestamp; // readTimestampCounter()
+    std::int32_t callId;
+    std::int32_t position;   // place in the queue at the event, 0 = front, -1 if rejected
+    LifecycleStage stage;
+    CallType type;
+    std::uint16_t thread;    // index of the recording thread
+};
 
+// Records when each call is enqueued, reprioritized and dequeued, for
+// investigating individual slow calls.
+//
+// Tracing is process-wide and switched at runtime with start()/stop(). While
+// it is off, each queue operation pays one relaxed load and a branch that is
+// predicted not taken. While it is on, events are stamped with the TSC into a
+// per-thread ring buffer that keeps the newest `eventsPerThread` events.
+// The TSC is calibrated against the monotonic clock between start() and
+// export, and exportChromeTrace() writes the Chrome trace / Perfetto JSON
+// format, showing each call as an async span from enqueue to dequeue.
+// Export after stop(), or expect the newest events to race with writers.
+class LifecycleTracer {
+private:
+    struct ThreadRing {
+        std::vector<LifecycleEvent> events;
+        std::atomic<std::uint64_t> written{ 0 };
+        std::uint16_t thread = 0;
+    };
+
+    static inline std::atomic<LifecycleTracer*> active{ nullptr };
+
+    PerThreadSlots<ThreadRing> threads;
+    std::atomic<std::uint16_t> nextThread{ 0 };
+    std::size_t ringSize;
+    std::uint64_t startTicks = 0;
+    std::int64_t startNs = 0;
+
+    ThreadRing& ring() {
+        ThreadRing& r = threads.local();
+        if (r.events.empty()) {
+            r.events.resize(ringSize);
+            r.thread = nextThread.fetch_add(1);
+        }
+        return r;
     }
-    // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Queue after prioritizing emergency calls:
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Dequeued Call ID: 2
-    // Dequeued Call ID: 4
-    // Queue after two dequeues:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
 
-    // Edge Case Test Case 2
+    // Nanoseconds per tick, measured from start() to now.
+    double calibrate() const {
+        std::uint64_t ticks = readTimestampCounter() - startTicks;
+        std::int64_t ns = nowNanos() - startNs;
+        return ticks > 0 ? static_cast<double>(ns) / ticks : 1.0;
+    }
 
-    {
-        CircularQueue cq(5);  std::cout << "\n\n";
+public:
+    // `eventsPerThread` is rounded up to a power of two.
+    explicit LifecycleTracer(std::size_t eventsPerThread = 1 << 16) : ringSize(1) {
+        while (ringSize < eventsPerThread) ringSize <<= 1;
+    }
 
-        Call call1 = { 1, CallType::NORMAL, 10, false };
-        Call call2 = { 2, CallType::EMERGENCY, 5, true };
-        Call call3 = { 3, CallType::NORMAL, 15, false };
-        Call call4 = { 4, CallType::EMERGENCY, 8, true };
-        Call call5 = { 5, CallType::NORMAL, 20, false };
+    ~LifecycleTracer() { stop(); }
 
-        cq.enqueue(call1);
-        cq.enqueue(call2);
-        cq.enqueue(call3);
-        cq.enqueue(call4);
-        cq.enqueue(call5);
+    // The tracer queues report to, or nullptr while tracing is off.
+    static LifecycleTracer* current() { return active.load(std::memory_order_relaxed); }
 
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
+    void start() {
+        startTicks = readTimestampCounter();
+        startNs = nowNanos();
+        active.store(this, std::memory_order_release);
+    }
 
-        cq.prioritizeEmergencyCalls();
+    void stop() {
+        LifecycleTracer* self = this;
+        active.compare_exchange_strong(self, nullptr);
+    }
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+    void record(LifecycleStage stage, const Call& call, int position) {
+        ThreadRing& r = ring();
+        std::uint64_t index = r.written.load(std::memory_order_relaxed);
+        LifecycleEvent& event = r.events[index & (ringSize - 1)];
+        event.timestamp = readTimestampCounter();
+        event.callId = call.callId;
+        event.position = position;
+        event.stage = stage;
+        event.type = call.type;
+        event.thread = r.thread;
+        r.written.store(index + 1, std::memory_order_release);
+    }
 
-        // Attempt to enqueue another call to test overflow
-        Call call6 = { 6, CallType::NORMAL, 12, false };
-        cq.enqueue(call6); // This should trigger Queue Overflow
+    // Events still held in the rings, oldest first.
+    std::vector<LifecycleEvent> events() const {
+        std::vector<LifecycleEvent> all;
+        threads.forEach([&](const ThreadRing& r) {
+            std::uint64_t written = r.written.load(std::memory_order_acquire);
+            std::uint64_t first = written > ringSize ? written - ringSize : 0;
+            for (std::uint64_t i = first; i < written; ++i) all.push_back(r.events[i & (ringSize - 1)]);
+        });
+        std::stable_sort(all.begin(), all.end(),
+            [](const LifecycleEvent& a, const LifecycleEvent& b) { return a.timestamp < b.timestamp; });
+        return all;
+    }
 
+    static const char* stageName(LifecycleStage stage) {
+        switch (stage) {
+        case LifecycleStage::ENQUEUED: return "ENQUEUED";
+        case LifecycleStage::REJECTED: return "REJECTED";
+        case LifecycleStage::REPRIORITIZED: return "REPRIORITIZED";
+        case LifecycleStage::DEQUEUED: return "DEQUEUED";
+        case LifecycleStage::CANCELLED: return "CANCELLED";
+        }
+        return "UNKNOWN";
+    }
 
+    bool exportChromeTrace(const std::string& path) const {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) return false;
+        double nsPerTick = calibrate();
+        std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+        bool first = true;
+        for (const LifecycleEvent& e : events()) {
+            // Async events: "b" opens the call's span, "n" marks a step, "e" closes it.
+            char phase = 'n';
+            if (e.stage == LifecycleStage::ENQUEUED) phase = 'b';
+            else if (e.stage == LifecycleStage::DEQUEUED || e.stage == LifecycleStage::CANCELLED) phase = 'e';
+            double us = static_cast<double>(static_cast<std::int64_t>(e.timestamp - startTicks)) * nsPerTick / 1000.0;
+            std::fprintf(file,
+                "%s{\"name\":\"Call %d\",\"cat\":\"%s\",\"ph\":\"%c\",\"id\":%d,\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"stage\":\"%s\",\"position\":%d}}",
+                first ? "" : ",\n", e.callId, e.type == CallType::EMERGENCY ? "EMERGENCY" : "NORMAL", phase,
+                e.callId, us, static_cast<unsigned>(e.thread), stageName(e.stage), e.position);
+            first = false;
+        }
+        std::fputs("\n]}\n", file);
+        return std::fclose(file) == 0;
     }
-    // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
-    // Queue after prioritizing emergency calls:
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
-    // Queue Overflow! Cannot enqueue call.
+};
 
-    // Happy Path Test Case 2
+// Running aggregates that answer "how long will I wait?" for a newly arriving
+// call in O(1). Attached queues keep it up to date on every enqueue, dequeue
+// and cancel. It tracks the calls and minutes of expected talk time waiting
+// per CallType, and an EWMA of the time between answered calls while callers
+// are waiting. One queue thread writes it. estimatedWaitNs may be called from
+// any thread, such as on every IVR prompt: it is a handful of relaxed atomic
+// loads.
+//
+// The estimate assumes emergency-first service: a new EMERGENCY call waits
+// behind the EMERGENCY calls only, and a new NORMAL call waits behind
+// everything. Once service has been observed, the estimate is calls ahead
+// times the recent answer interval. Until then, it is the queued minutes
+// spread over the agents.
+class WaitEstimator {
+private:
+    std::atomic<std::int64_t> queuedCalls[2] = {};
+    std::atomic<std::int64_t> queuedMinutes[2] = {};
+    std::atomic<int> agents;
+    std::atomic<std::int64_t> answerIntervalNs{ 0 }; // 0 until measured
+    std::int64_t lastAnswerNs = 0;                    // while callers were still waiting, else 0
+
+    static void add(std::atomic<std::int64_t>& value, std::int64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
 
-    {
-        CircularQueue cq(4);
+public:
+    explicit WaitEstimator(int agentCount = 1) : agents(std::max(agentCount, 1)) {}
 
-        Call call1 = { 1, CallType::NORMAL, 10, false };
-        Call call2 = { 2, CallType::EMERGENCY, 5, true };
-        Call call3 = { 3, CallType::NORMAL, 15, false };
-        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+    void setAgentCount(int agentCount) { agents.store(std::max(agentCount, 1), std::memory_order_relaxed); }
 
-        cq.enqueue(call1);
-        cq.enqueue(call2);
-        cq.enqueue(call3);
-        cq.enqueue(call4);
+    void onEnqueue(const Call& call) {
+        add(queuedCalls[static_cast<int>(call.type)], 1);
+        add(queuedMinutes[static_cast<int>(call.type)], call.duration);
+    }
 
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
+    // A waiting call left the queue without being answered.
+    void onRemove(const Call& call) {
+        add(queuedCalls[static_cast<int>(call.type)], -1);
+        add(queuedMinutes[static_cast<int>(call.type)], -call.duration);
+    }
 
-        cq.prioritizeEmergencyCalls();
+    // An agent answered `call`. The interval since the previous answer counts
+    // only if callers were waiting throughout; idle agents say nothing about
+    // how fast calls are answered.
+    void onAnswer(const Call& call, std::int64_t nowNs) {
+        onRemove(call);
+        if (lastAnswerNs) {
+            std::int64_t interval = nowNs - lastAnswerNs;
+            std::int64_t average = answerIntervalNs.load(std::memory_order_relaxed);
+            answerIntervalNs.store(average ? average + (interval - average) / 8 : interval, std::memory_order_relaxed);
+        }
+        bool stillWaiting = queuedCalls[0].load(std::memory_order_relaxed) + queuedCalls[1].load(std::memory_order_relaxed) > 0;
+        lastAnswerNs = stillWaiting ? nowNs : 0;
+    }
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+    std::int64_t estimatedWaitNs(CallType type) const {
+        std::int64_t callsAhead = queuedCalls[1].load(std::memory_order_relaxed);
+        std::int64_t minutesAhead = queuedMinutes[1].load(std::memory_order_relaxed);
+        if (type == CallType::NORMAL) {
+            callsAhead += queuedCalls[0].load(std::memory_order_relaxed);
+            minutesAhead += queuedMinutes[0].load(std::memory_order_relaxed);
+        }
+        if (std::int64_t interval = answerIntervalNs.load(std::memory_order_relaxed)) return callsAhead * interval;
+        return minutesAhead * 60 * 1000000000LL / agents.load(std::memory_order_relaxed);
+    }
+};
 
-        cq.dequeue();
-        cq.dequeue();
+// Binary indexed tree over int64 values: point updates and prefix sums in
+// O(log n), and an O(n) bulk build.
+class FenwickTree {
+private:
+    std::vector<std::int64_t> tree; // 1-based
 
-        std::cout << "Queue after two dequeues:\n";
-        cq.display();  std::cout << "\n\n";
+public:
+    explicit FenwickTree(int size = 0) : tree(size + 1, 0) {}
 
+    int size() const { return static_cast<int>(tree.size()) - 1; }
 
+    // Replaces every value: values[i] becomes element i.
+    void assign(const std::vector<std::int64_t>& values) {
+        tree.assign(values.size() + 1, 0);
+        for (std::size_t i = 1; i < tree.size(); ++i) {
+            tree[i] += values[i - 1];
+            std::size_t parent = i + (i & (~i + 1));
+            if (parent < tree.size()) tree[parent] += tree[i];
+        }
     }
-    // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Queue after prioritizing emergency calls:
+
+    void add(int index, std::int64_t delta) {
+        for (std::size_t i = index + 1; i < tree.size(); i += i & (~i + 1)) tree[i] += delta;
+    }
+
+    // Sum of elements [0, end).
+    std::int64_t prefix(int end) const {
+        std::int64_t sum = 0;
+        for (std::size_t i = end; i > 0; i &= i - 1) sum += tree[i];
+        return sum;
+    }
+
+    // Sum of elements [begin, end).
+    std::int64_t range(int begin, int end) const { return prefix(end) - prefix(begin); }
+};
+
+// Answers, for any waiting call, how many calls are ahead of it and how many
+// minutes of expected talk time they add up to, in O(log n).
+//
+// The Fenwick tree is indexed by ring slot and holds each occupied slot's
+// Call::duration. The calls ahead of a slot are the slots from the queue front
+// up to it, wrapping past the end of the ring when needed, so one or two
+// prefix sums cover them. A call's rank is its slot's distance from the front.
+// CircularQueue allows repeated callIds (a redial can reuse one), so the
+// slots holding each callId are chained front to back through per-slot links,
+// and a hash map keeps each callId's first and last slot. Queries by callId
+// answer for its frontmost call, the one cancel(callId) would remove.
+//
+// An attached CircularQueue keeps the index current. Enqueue, dequeue and
+// removing either end update one slot each. Cancelling from the middle and
+// prioritizeEmergencyCalls move many calls, already taking O(n), so they
+// rebuild the index in O(n).
+class QueuePositionIndex {
+private:
+    struct SlotChain {
+        int first; // frontmost slot holding the callId
+        int last;  // newest slot holding it
+    };
+
+    FenwickTree durations;
+    std::unordered_map<int, SlotChain> slotsOf; // callId -> its slots
+    std::vector<int> nextSame; // by slot: next slot with the same callId, -1 at the end
+    std::vector<int> prevSame; // by slot: previous slot with the same callId, -1 at the start
+    int capacity = 0;
+    int head = 0; // ring slot of the front call
+    int count = 0;
+
+    int slotOfCall(int callId) const {
+        auto found = slotsOf.find(callId);
+        return found == slotsOf.end() ? -1 : found->second.first;
+    }
+
+    void link(int slot, int callId) {
+        nextSame[slot] = -1;
+        auto [chain, added] = slotsOf.try_emplace(callId, SlotChain{ slot, slot });
+        if (added) {
+            prevSame[slot] = -1;
+            return;
+        }
+        nextSame[chain->second.last] = slot;
+        prevSame[slot] = chain->second.last;
+        chain->second.last = slot;
+    }
+
+    // Unlinks `slot`, which is its callId's first or last slot.
+    void unlink(int slot, int callId) {
+        auto chain = slotsOf.find(callId);
+        if (chain == slotsOf.end()) return;
+        if (chain->second.first == chain->second.last) {
+            slotsOf.erase(chain);
+        }
+        else if (chain->second.first == slot) {
+            chain->second.first = nextSame[slot];
+            prevSame[nextSame[slot]] = -1;
+        }
+        else {
+            chain->second.last = prevSame[slot];
+            nextSame[prevSame[slot]] = -1;
+        }
+    }
+
+public:
+    // Indexes the `size` calls of `ring` starting at slot `front`.
+    template <typename Ring>
+    void rebuild(const Ring& ring, int front, int size) {
+        capacity = static_cast<int>(ring.size());
+        head = size ? front : 0;
+        count = size;
+        std::vector<std::int64_t> values(capacity, 0);
+        nextSame.assign(capacity, -1);
+        prevSame.assign(capacity, -1);
+        slotsOf.clear();
+        slotsOf.reserve(capacity);
+        for (int i = 0, slot = front; i < size; ++i, slot = (slot + 1) % capacity) {
+            values[slot] = ring[slot].duration;
+            link(slot, ring[slot].callId);
+        }
+        durations.assign(values);
+    }
+
+    void onEnqueue(int slot, const Call& call) {
+        if (count++ == 0) head = slot;
+        durations.add(slot, call.duration);
+        link(slot, call.callId);
+    }
+
+    // The front call, in `slot`, left the queue.
+    void onPopFront(int slot, const Call& call) {
+        durations.add(slot, -call.duration);
+        unlink(slot, call.callId);
+        head = (slot + 1) % capacity;
+        --count;
+    }
+
+    // The newest call, in `slot`, left the queue.
+    void onPopBack(int slot, const Call& call) {
+        durations.add(slot, -call.duration);
+        unlink(slot, call.callId);
+        --count;
+    }
+
+    // Calls ahead of the frontmost call with `callId` (0 for the next call
+    // answered), or -1 if none is waiting.
+    int rankOf(int callId) const {
+        int slot = slotOfCall(callId);
+        return slot < 0 ? -1 : (slot - head + capacity) % capacity;
+    }
+
+    // Minutes of expected talk time among the first `rank` calls in line.
+    std::int64_t durationAheadOfRank(int rank) const {
+        rank = std::clamp(rank, 0, count);
+        int end = head + rank;
+        if (end <= capacity) return durations.range(head, end);
+        return durations.range(head, capacity) + durations.prefix(end - capacity);
+    }
+
+    // Minutes of expected talk time ahead of `callId`, or -1 if it is not waiting.
+    std::int64_t durationAhead(int callId) const {
+        int rank = rankOf(callId);
+        return rank < 0 ? -1 : durationAheadOfRank(rank);
+    }
+
+    // Expected wait of `callId` with `agents` agents working through the calls
+    // ahead of it, or -1 if it is not waiting.
+    std::int64_t expectedWaitNs(int callId, int agents) const {
+        std::int64_t minutes = durationAhead(callId);
+        return minutes < 0 ? -1 : minutes * 60 * 1000000000LL / std::max(agents, 1);
+    }
+};
+
+enum class RingBacking { SMALL_PAGES, TRANSPARENT_HUGE_PAGES, EXPLICIT_HUGE_PAGES };
+
+inline const char* ringBackingName(RingBacking backing) {
+    switch (backing) {
+    case RingBacking::SMALL_PAGES: return "small_pages";
+    case RingBacking::TRANSPARENT_HUGE_PAGES: return "transparent_huge_pages";
+    case RingBacking::EXPLICIT_HUGE_PAGES: return "explicit_huge_pages";
+    }
+    return "unknown";
+}
+
+// What the kernel actually backs the mapping containing `address` with,
+// according to /proc/self/smaps. Huge pages are only a request, so this is how
+// a queue reports what it really got.
+inline RingBacking observedBacking(const void* address) {
+    FILE* smaps = std::fopen("/proc/self/smaps", "r");
+    if (!smaps) return RingBacking::SMALL_PAGES;
+    std::uintptr_t target = reinterpret_cast<std::uintptr_t>(address);
+    RingBacking backing = RingBacking::SMALL_PAGES;
+    bool inMapping = false;
+    char line[512];
+    while (std::fgets(line, sizeof(line), smaps)) {
+        unsigned long begin, end;
+        if (std::sscanf(line, "%lx-%lx ", &begin, &end) == 2 && std::strchr(line, '-') < std::strchr(line, ' ')) {
+            if (inMapping) break;
+            inMapping = target >= begin && target < end;
+            continue;
+        }
+        if (!inMapping) continue;
+        unsigned long kilobytes;
+        if (std::sscanf(line, "KernelPageSize: %lu kB", &kilobytes) == 1 && kilobytes >= 2048) {
+            backing = RingBacking::EXPLICIT_HUGE_PAGES;
+        }
+        else if (std::sscanf(line, "AnonHugePages: %lu kB", &kilobytes) == 1 && kilobytes > 0
+            && backing == RingBacking::SMALL_PAGES) {
+            backing = RingBacking::TRANSPARENT_HUGE_PAGES;
+        }
+    }
+    std::fclose(smaps);
+    return backing;
+}
+
+// Per-queue store for caller metadata. Each distinct string is kept once
+// (interned) and named by a StringHandle, so Call stays trivially copyable and
+// reading a dequeued call's metadata allocates nothing.
+//
+// Strings are bump-allocated in blocks of the active generation. Each
+// generation gets an epoch unique within the process, and a call's CallerInfo
+// records the epoch that issued its handles. Lookups check it, so a handle
+// from another queue's arena, or from a generation since released, reads as
+// empty rather than as another caller's string. Only calls carrying the
+// active epoch are counted as referring to it.
+//
+// Memory stays bounded whether or not the queue drains:
+// - the next intern() releases the generation in bulk once no waiting call
+//   refers to it;
+// - once it holds `compactBytes`, or twice what the last compaction kept, the
+//   owning queue compacts it. The waiting calls' strings are copied into a
+//   fresh generation, their handles are rewritten, and the old one is released.
+// Either way a dequeued call's strings stay readable until the next intern().
+//
+// Epochs are unique only within a process: the counter restarts with every
+// run and a fork()ed child inherits it. Calls read back from another process
+// (PersistentCircularQueue, SharedCallQueue) therefore come out with their
+// caller cleared, as do calls replayed from a WriteAheadLog or a replication
+// leader. Known limitation: the strings themselves are not journaled, so
+// recovery and a promoted standby restore calls without caller metadata.
+class CallerArena {
+private:
+    static constexpr std::size_t kBlockBytes = 64 << 10;
+
+    struct Slot {
+        std::uint32_t index; // into strings, 0 for a free slot
+        std::uint32_t tag;   // high hash bits, checked before comparing text
+    };
+
+    struct Generation {
+        std::vector<std::unique_ptr<char[]>> blocks;
+        std::size_t firstBlockBytes = 0;
+        std::size_t blockBytes = 0; // size of blocks.back()
+        std::size_t blockUsed = 0;  // bytes taken from blocks.back()
+        std::size_t reservedBytes = 0;
+        std::size_t stringBytes = 0;
+        std::vector<std::string_view> strings; // by index; 0 is "", added with the first string
+        std::vector<Slot> slots; // open addressing
+        std::uint32_t epoch = 0; // 0 until the first string after a release
+        int liveCalls = 0;       // waiting calls holding handles of this epoch
+    };
+
+    static inline std::atomic<std::uint32_t> nextEpoch{ 1 };
+
+    Generation generations[2];
+    int active = 0;
+    std::size_t compactBytes;
+    std::size_t compactAt;
+
+    // Drops every string and retires the epoch, keeping one block for the
+    // strings to come.
+    static void release(Generation& generation) {
+        if (generation.blocks.size() > 1) generation.blocks.erase(generation.blocks.begin() + 1, generation.blocks.end());
+        generation.blockBytes = generation.firstBlockBytes;
+        generation.blockUsed = 0;
+        generation.reservedBytes = generation.firstBlockBytes;
+        generation.stringBytes = 0;
+        if (!generation.strings.empty()) generation.strings.resize(1);
+        std::fill(generation.slots.begin(), generation.slots.end(), Slot{ 0, 0 });
+        generation.epoch = 0;
+        generation.liveCalls = 0;
+    }
+
+    static std::string_view store(Generation& generation, std::string_view text) {
+        if (generation.blockUsed + text.size() > generation.blockBytes) {
+            std::size_t bytes = std::max(kBlockBytes, text.size());
+            if (generation.blocks.empty()) generation.firstBlockBytes = bytes;
+            generation.blocks.push_back(std::make_unique_for_overwrite<char[]>(bytes));
+            generation.blockBytes = bytes;
+            generation.blockUsed = 0;
+            generation.reservedBytes += bytes;
+        }
+        char* out = generation.blocks.back().get() + generation.blockUsed;
+        std::memcpy(out, text.data(), text.size());
+        generation.blockUsed += text.size();
+        generation.stringBytes += text.size();
+        return std::string_view(out, text.size());
+    }
+
+    static void grow(Generation& generation) {
+        generation.slots.assign(std::max<std::size_t>(64, 2 * generation.slots.size()), Slot{ 0, 0 });
+        std::size_t mask = generation.slots.size() - 1;
+        for (std::uint32_t index = 1; index < generation.strings.size(); ++index) {
+            std::size_t hash = std::hash<std::string_view>{}(generation.strings[index]);
+            std::size_t slot = hash & mask;
+            while (generation.slots[slot].index != 0) slot = (slot + 1) & mask;
+            generation.slots[slot] = { index, static_cast<std::uint32_t>(hash >> 32) };
+        }
+    }
+
+    // Finds or adds `text` in `generation`, whose table must have room for it.
+    static StringHandle internInto(Generation& generation, std::string_view text, std::size_t hash) {
+        if (text.empty()) return 0;
+        std::uint32_t tag = static_cast<std::uint32_t>(hash >> 32);
+        std::size_t mask = generation.slots.size() - 1;
+        for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            Slot& entry = generation.slots[slot];
+            if (entry.index == 0) {
+                if (generation.strings.empty()) generation.strings.emplace_back();
+                entry = { static_cast<std::uint32_t>(generation.strings.size()), tag };
+                generation.strings.push_back(store(generation, text));
+                return entry.index;
+            }
+            if (entry.tag == tag && generation.strings[entry.index] == text) return entry.index;
+        }
+    }
+
+    // Handles for one call's metadata, all issued under `generation`'s epoch.
+    static CallerInfo internAll(Generation& generation, std::string_view number, std::string_view language,
+                                std::string_view account) {
+        if (number.empty() && language.empty() && account.empty()) return {};
+        while (generation.epoch == 0) generation.epoch = nextEpoch.fetch_add(1, std::memory_order_relaxed);
+        if (2 * (generation.strings.size() + 4) > generation.slots.size()) grow(generation);
+        std::hash<std::string_view> hash;
+        return { internInto(generation, number, hash(number)), internInto(generation, language, hash(language)),
+            internInto(generation, account, hash(account)), generation.epoch };
+    }
+
+    std::string_view text(const CallerInfo& caller, StringHandle handle) const {
+        if (caller.epoch == 0) return std::string_view();
+        for (const Generation& generation : generations) {
+            if (generation.epoch == caller.epoch) {
+                return handle < generation.strings.size() ? generation.strings[handle] : std::string_view();
+            }
+        }
+        return std::string_view();
+    }
+
+public:
+    explicit CallerArena(std::size_t generationBytes = 1 << 20) : compactBytes(generationBytes), compactAt(generationBytes) {}
+
+    CallerInfo intern(std::string_view number, std::string_view language, std::string_view account) {
+        Generation& generation = generations[active];
+        if (generation.liveCalls == 0 && generation.epoch != 0) {
+            release(generation);
+            compactAt = compactBytes;
+        }
+        return internAll(generation, number, language, account);
+    }
+
+    // The caller's strings, empty if the call has none or its handles were
+    // not issued by this arena's current generation.
+    std::string_view number(const CallerInfo& caller) const { return text(caller, caller.number); }
+    std::string_view language(const CallerInfo& caller) const { return text(caller, caller.language); }
+    std::string_view account(const CallerInfo& caller) const { return text(caller, caller.account); }
+
+    // Called by the owning queue as calls enter and leave it.
+    void onEnqueue(const CallerInfo& caller) {
+        if (caller.epoch != 0 && caller.epoch == generations[active].epoch) ++generations[active].liveCalls;
+    }
+
+    void onRemove(const CallerInfo& caller) {
+        if (caller.epoch != 0 && caller.epoch == generations[active].epoch) --generations[active].liveCalls;
+    }
+
+    // True when the active generation should be compacted before the next
+    // intern(): beginCompaction(), relocate() every waiting call's caller,
+    // then endCompaction().
+    bool needsCompaction() const {
+        return generations[active].liveCalls > 0 && generations[active].stringBytes >= compactAt;
+    }
+
+    void beginCompaction() { release(generations[1 - active]); }
+
+    // Copies a waiting call's strings into the new generation and rewrites
+    // its handles.
+    void relocate(CallerInfo& caller) {
+        if (caller.epoch == 0 || caller.epoch != generations[active].epoch) return;
+        Generation& target = generations[1 - active];
+        caller = internAll(target, number(caller), language(caller), account(caller));
+        ++target.liveCalls;
+    }
+
+    void endCompaction() {
+        release(generations[active]);
+        active = 1 - active;
+        compactAt = std::max(compactBytes, 2 * generations[active].stringBytes);
+    }
+
+    // Forgets every string and every reference, e.g. before a recovery.
+    void clear() {
+        for (Generation& generation : generations) release(generation);
+        active = 0;
+        compactAt = compactBytes;
+    }
+
+    int stringCount() const {
+        int count = 0;
+        for (const Generation& generation : generations) count += std::max(0, static_cast<int>(generation.strings.size()) - 1);
+        return count;
+    }
+
+    std::size_t stringBytes() const { return generations[0].stringBytes + generations[1].stringBytes; }
+
+    // Block memory held, including blocks kept for reuse.
+    std::size_t reservedBytes() const { return generations[0].reservedBytes + generations[1].reservedBytes; }
+};
+
+// Allocator for ring storage. SMALL_PAGES allocates from the heap as usual.
+// For rings of 2 MB and up, the huge-page options map the ring directly:
+// - EXPLICIT_HUGE_PAGES asks for MAP_HUGETLB pages from the reserved pool.
+// - If that pool is empty, or TRANSPARENT_HUGE_PAGES was requested, it maps
+//   2 MB-aligned memory and madvises it for transparent huge pages.
+// Either way the allocation succeeds. Use observedBacking() to learn what the
+// kernel provided.
+template <typename T>
+class RingAllocator {
+private:
+    static constexpr std::size_t kHugePage = 2 << 20;
+
+    static std::size_t mappedBytes(std::size_t n) { return (n * sizeof(T) + kHugePage - 1) & ~(kHugePage - 1); }
+
+    bool mapsDirectly(std::size_t n) const { return requested != RingBacking::SMALL_PAGES && n * sizeof(T) >= kHugePage; }
+
+public:
+    using value_type = T;
+
+    RingBacking requested = RingBacking::SMALL_PAGES;
+
+    RingAllocator() = default;
+    explicit RingAllocator(RingBacking backing) : requested(backing) {}
+    template <typename U>
+    RingAllocator(const RingAllocator<U>& other) : requested(other.requested) {}
+
+    T* allocate(std::size_t n) {
+        if (!mapsDirectly(n)) return static_cast<T*>(::operator new(n * sizeof(T)));
+        std::size_t bytes = mappedBytes(n);
+        if (requested == RingBacking::EXPLICIT_HUGE_PAGES) {
+            void* mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mapping != MAP_FAILED) return static_cast<T*>(mapping);
+        }
+        // Over-map by one huge page, then trim to a 2 MB-aligned range that
+        // the kernel can back with whole huge pages.
+        void* mapping = ::mmap(nullptr, bytes + kHugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) throw std::bad_alloc();
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(mapping);
+        std::uintptr_t aligned = (start + kHugePage - 1) & ~(kHugePage - 1);
+        if (aligned > start) ::munmap(mapping, aligned - start);
+        std::uintptr_t tail = aligned + bytes;
+        if (start + bytes + kHugePage > tail) ::munmap(reinterpret_cast<void*>(tail), start + bytes + kHugePage - tail);
+        ::madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        if (mapsDirectly(n)) ::munmap(p, mappedBytes(n));
+        else ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const RingAllocator<U>& other) const { return requested == other.requested; }
+};
+
+class CircularQueue {
+private:
+    std::vector<Call, RingAllocator<Call>> queue;
+    // Second ring for the parallel prioritize, allocated with the ring's
+    // backing on first use and kept for reuse: from then on the queue holds
+    // twice its ring memory, until releasePrioritizeBuffer().
+    std::vector<Call, RingAllocator<Call>> scratch;
+    int front, rear, capacity;
+    int depthByType[2] = { 0, 0 };
+    QueueJournal* journal = nullptr;
+    WaitTimeRecorder* waitRecorder = nullptr;
+    QueueMetrics* metrics = nullptr;
+    WaitEstimator* estimator = nullptr;
+    QueuePositionIndex* positions = nullptr;
+    CallerArena callers;
+    bool verbose = true;
+
+    friend class WriteAheadLog;
+
+    // Bookkeeping once a prioritize has left the calls at ring index 0 onward.
+    void finishPrioritize() {
+        if (positions) positions->rebuild(queue, front, size());
+        if (metrics) metrics->countReprioritization();
+        if (LifecycleTracer* tracer = LifecycleTracer::current()) [[unlikely]] {
+            for (int index = 0; index < size() && queue[index].type == CallType::EMERGENCY; ++index) {
+                tracer->record(LifecycleStage::REPRIORITIZED, queue[index], index);
+            }
+        }
+        if (journal) journal->record(QueueOp::PRIORITIZE, nullptr);
+    }
+
+public:
+    // Smallest share of the queue worth handing to another thread when
+    // prioritizing in parallel.
+    static constexpr int kMinCallsPerThread = 1 << 15;
+
+    CircularQueue(int size) : capacity(size), front(-1), rear(-1) {
+        queue.resize(capacity);
+    }
+
+    // Ring storage backed as requested where possible; see RingAllocator.
+    CircularQueue(int size, RingBacking backing)
+        : queue(RingAllocator<Call>(backing)), scratch(RingAllocator<Call>(backing)), front(-1), rear(-1), capacity(size) {
+        queue.resize(capacity);
+    }
+
+    // What the kernel actually backs the ring with.
+    RingBacking ringBacking() const { return observedBacking(queue.data()); }
+
+    // Every successful enqueue/dequeue/prioritize is reported to the journal.
+    void attachJournal(QueueJournal* j) { journal = j; }
+
+    // While attached, enqueue stamps each call and dequeue records how long
+    // it waited.
+    void attachWaitRecorder(WaitTimeRecorder* recorder) { waitRecorder = recorder; }
+
+    // Counts this queue's operations into `queueMetrics` (nullptr detaches).
+    void attachMetrics(QueueMetrics* queueMetrics) {
+        for (CallType type : { CallType::NORMAL, CallType::EMERGENCY }) {
+            if (metrics) metrics->adjustDepth(type, -depthByType[static_cast<int>(type)]);
+            if (queueMetrics) queueMetrics->adjustDepth(type, depthByType[static_cast<int>(type)]);
+        }
+        metrics = queueMetrics;
+    }
+
+    // Keeps `waitEstimator` current with this queue's calls (nullptr detaches).
+    void attachWaitEstimator(WaitEstimator* waitEstimator) {
+        for (int i = 0, index = front; i < size(); ++i, index = (index + 1) % capacity) {
+            if (estimator) estimator->onRemove(queue[index]);
+            if (waitEstimator) waitEstimator->onEnqueue(queue[index]);
+        }
+        estimator = waitEstimator;
+    }
+
+    // Keeps `index` current with this queue's positions (nullptr detaches).
+    void attachPositionIndex(QueuePositionIndex* index) {
+        positions = index;
+        if (positions) positions->rebuild(queue, front, size());
+    }
+
+    // When false, enqueue/dequeue no longer print to stdout.
+    void setVerbose(bool enabled) { verbose = enabled; }
+
+    int getCapacity() const { return capacity; }
+
+    // Calls of `type` currently waiting.
+    int countOf(CallType type) const { return depthByType[static_cast<int>(type)]; }
+
+    int size() const {
+        if (front == -1) return 0;
+        return (rear - front + capacity) % capacity + 1;
+    }
+
+    bool isFull() const {
+        return ((rear + 1) % capacity == front);
+    }
+
+    bool isEmpty() const {
+        return (front == -1);
+    }
+
+    // The call at the front, or nullptr when the queue is empty.
+    const Call* peek() const {
+        return isEmpty() ? nullptr : &queue[front];
+    }
+
+    // The call `position` places behind the front (0 is the front); the
+    // position must be below size().
+    const Call& at(int position) const {
+        return queue[(front + position) % capacity];
+    }
+
+    // Random-access iterator over the waiting calls, front to back, reading
+    // the ring in place across the wrap. Read-only: changing calls behind the
+    // queue's back would bypass its journal and bookkeeping. Invalidated by
+    // any operation that changes the queue.
+    class const_iterator {
+    private:
+        const Call* ring = nullptr;
+        int capacity = 1;
+        int front = 0;
+        int position = 0; // logical, 0 is the front
+
+        const Call& slot(int logical) const {
+            int index = front + logical;
+            return ring[index >= capacity ? index - capacity : index];
+        }
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using iterator_concept = std::random_access_iterator_tag;
+        using value_type = Call;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Call*;
+        using reference = const Call&;
+
+        const_iterator() = default;
+        const_iterator(const Call* ringData, int ringCapacity, int frontIndex, int logicalPosition)
+            : ring(ringData), capacity(ringCapacity), front(frontIndex), position(logicalPosition) {}
+
+        reference operator*() const { return slot(position); }
+        pointer operator->() const { return &slot(position); }
+        reference operator[](difference_type offset) const { return slot(position + static_cast<int>(offset)); }
+
+        const_iterator& operator++() { ++position; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++position; return old; }
+        const_iterator& operator--() { --position; return *this; }
+        const_iterator operator--(int) { const_iterator old = *this; --position; return old; }
+        const_iterator& operator+=(difference_type offset) { position += static_cast<int>(offset); return *this; }
+        const_iterator& operator-=(difference_type offset) { position -= static_cast<int>(offset); return *this; }
+
+        friend const_iterator operator+(const_iterator it, difference_type offset) { return it += offset; }
+        friend const_iterator operator+(difference_type offset, const_iterator it) { return it += offset; }
+        friend const_iterator operator-(const_iterator it, difference_type offset) { return it -= offset; }
+        friend difference_type operator-(const const_iterator& a, const const_iterator& b) { return a.position - b.position; }
+        friend bool operator==(const const_iterator& a, const const_iterator& b) { return a.position == b.position; }
+        friend auto operator<=>(const const_iterator& a, const const_iterator& b) { return a.position <=> b.position; }
+    };
+
+    const_iterator begin() const { return const_iterator(queue.data(), capacity, isEmpty() ? 0 : front, 0); }
+    const_iterator end() const { return const_iterator(queue.data(), capacity, isEmpty() ? 0 : front, size()); }
+
+    // The waiting calls as a view, for range adaptors:
+    //     cq.calls() | std::views::filter(...)
+    auto calls() const { return std::ranges::subrange<const_iterator>(begin(), end()); }
+
+    bool enqueue(const Call& call) {
+        if (journal && journal->failed()) [[unlikely]] {
+            if (verbose) std::cout << "Journal failed! Cannot enqueue call.\n";
+            return false;
+        }
+        if (isFull()) {
+            if (metrics) metrics->count(QueueMetrics::OVERFLOWS, call.type);
+            if (LifecycleTracer* tracer = LifecycleTracer::current()) [[unlikely]] {
+                tracer->record(LifecycleStage::REJECTED, call, -1);
+            }
+            if (verbose) std::cout << "Queue Overflow! Cannot enqueue call.\n";
+            return false;
+        }
+        if (front == -1) front = 0;
+        rear = (rear + 1) % capacity;
+        queue[rear] = call;
+        int depth = ++depthByType[static_cast<int>(call.type)];
+        if (metrics) {
+            metrics->count(QueueMetrics::ENQUEUES, call.type);
+            metrics->observeDepth(call.type, depth);
+        }
+        if (LifecycleTracer* tracer = LifecycleTracer::current()) [[unlikely]] {
+            tracer->record(LifecycleStage::ENQUEUED, call, size() - 1);
+        }
+        if (waitRecorder) queue[rear].enqueuedAtNs = nowNanos();
+        if (estimator) estimator->onEnqueue(call);
+        if (positions) positions->onEnqueue(rear, call);
+        callers.onEnqueue(call.caller);
+        if (journal) journal->record(QueueOp::ENQUEUE, &queue[rear]);
+        if (verbose) std::cout << "Enqueued Call ID: " << call.callId << "\n";
+        return true;
+    }
+
+    // Enqueues `call` with its caller's metadata interned in this queue's
+    // arena, compacting the arena first when it has grown past its bound.
+    bool enqueue(Call call, std::string_view callerNumber, std::string_view language, std::string_view account) {
+        if (isFull()) return enqueue(call);
+        if (callers.needsCompaction()) {
+            callers.beginCompaction();
+            for (int i = 0, index = front; i < size(); ++i, index = (index + 1) % capacity) {
+                callers.relocate(queue[index].caller);
+            }
+            callers.endCompaction();
+        }
+        call.caller = callers.intern(callerNumber, language, account);
+        return enqueue(call);
+    }
+
+    // Metadata of a call from this queue, empty for calls without any or
+    // from another queue. The text stays valid while the call waits and,
+    // once it has left, until the next enqueue with metadata.
+    std::string_view callerNumber(const Call& call) const { return callers.number(call.caller); }
+    std::string_view callerLanguage(const Call& call) const { return callers.language(call.caller); }
+    std::string_view callerAccount(const Call& call) const { return callers.account(call.caller); }
+
+    const CallerArena& callerArena() const { return callers; }
+
+    bool dequeue() {
+        Call call;
+        return dequeue(call);
+    }
+
+    bool dequeue(Call& out) {
+        if (isEmpty()) {
+            if (metrics) metrics->countUnderflow();
+            if (verbose) std::cout << "Queue Underflow! Cannot dequeue call.\n";
+            return false;
+        }
+        out = queue[front];
+        --depthByType[static_cast<int>(out.type)];
+        if (metrics) metrics->count(QueueMetrics::DEQUEUES, out.type);
+        if (LifecycleTracer* tracer = LifecycleTracer::current()) [[unlikely]] {
+            tracer->record(LifecycleStage::DEQUEUED, out, 0);
+        }
+        if (waitRecorder && out.enqueuedAtNs) waitRecorder->record(out.type, nowNanos() - out.enqueuedAtNs);
+        if (estimator) estimator->onAnswer(out, nowNanos());
+        if (positions) positions->onPopFront(front, out);
+        callers.onRemove(out.caller);
+        if (verbose) std::cout << "Dequeued Call ID: " << out.callId << "\n";
+        if (front == rear) {
+            front = rear = -1; // Reset queue
+        }
+        else {
+            front = (front + 1) % capacity;
+        }
+        if (journal) journal->record(QueueOp::DEQUEUE, &out);
+        return true;
+    }
+
+    // Removes a waiting call (e.g. the caller hung up), keeping the order of
+    // the calls behind it.
+    bool cancel(int callId) {
+        if (isEmpty()) return false;
+        int index = front;
+        while (queue[index].callId != callId) {
+            if (index == rear) {
+                if (verbose) std::cout << "Call ID " << callId << " is not in the queue.\n";
+                return false;
+            }
+            index = (index + 1) % capacity;
+        }
+        Call removed = queue[index];
+        --depthByType[static_cast<int>(removed.type)];
+        if (metrics) metrics->count(QueueMetrics::CANCELLATIONS, removed.type);
+        if (estimator) estimator->onRemove(removed);
+        callers.onRemove(removed.caller);
+        if (LifecycleTracer* tracer = LifecycleTracer::current()) [[unlikely]] {
+            tracer->record(LifecycleStage::CANCELLED, removed, (index - front + capacity) % capacity);
+        }
+        if (index == front) {
+            // Nothing ahead of it to close up: advance the front, in O(1).
+            if (positions) positions->onPopFront(index, removed);
+            if (front == rear) {
+                front = rear = -1;
+            }
+            else {
+                front = (front + 1) % capacity;
+            }
+        }
+        else {
+            while (index != rear) {
+                int next = (index + 1) % capacity;
+                queue[index] = queue[next];
+                index = next;
+            }
+            rear = (rear - 1 + capacity) % capacity;
+            if (positions) positions->rebuild(queue, front, size());
+        }
+        if (journal) journal->record(QueueOp::CANCEL, &removed);
+        if (verbose) std::cout << "Cancelled Call ID: " << callId << "\n";
+        return true;
+    }
+
+    // Removes the most recently enqueued call in O(1), e.g. to shed it under
+    // overload. Counted and journaled as a cancellation.
+    bool removeNewest(Call& out) {
+        if (isEmpty()) return false;
+        out = queue[rear];
+        --depthByType[static_cast<int>(out.type)];
+        if (metrics) metrics->count(QueueMetrics::CANCELLATIONS, out.type);
+        if (estimator) estimator->onRemove(out);
+        if (positions) positions->onPopBack(rear, out);
+        callers.onRemove(out.caller);
+        if (LifecycleTracer* tracer = LifecycleTracer::current()) [[unlikely]] {
+            tracer->record(LifecycleStage::CANCELLED, out, size() - 1);
+        }
+        if (front == rear) {
+            front = rear = -1;
+        }
+        else {
+            rear = (rear - 1 + capacity) % capacity;
+        }
+        if (journal) journal->record(QueueOp::REMOVE_NEWEST, &out);
+        if (verbose) std::cout << "Cancelled Call ID: " << out.callId << "\n";
+        return true;
+    }
+
+    void display() {
+        if (isEmpty()) {
+            std::cout << "Queue is empty.\n";
+            return;
+        }
+        int index = front;
+        do {
+            std::cout << "Call ID: " << queue[index].callId
+                << ", Type: " << (queue[index].type == CallType::NORMAL ? "NORMAL" : "EMERGENCY")
+                << ", Duration: " << queue[index].duration
+                << ", Callback Requested: " << (queue[index].callbackRequested ? "Yes" : "No")
+                << "\n";
+            index = (index + 1) % capacity;
+        } while (index != (rear + 1) % capacity);
+    }
+
+    void prioritizeEmergencyCalls() {
+        if (isEmpty()) return;
+
+        std::vector<Call> tempQueue;
+        int count = size();
+
+        // Collect emergency calls first (walking from front, across the wrap)
+        for (int i = 0, index = front; i < count; ++i, index = (index + 1) % capacity) {
+            if (queue[index].type == CallType::EMERGENCY) {
+                tempQueue.push_back(queue[index]);
+            }
+        }
+
+        // Then, collect normal calls
+        for (int i = 0, index = front; i < count; ++i, index = (index + 1) % capacity) {
+            if (queue[index].type == CallType::NORMAL) {
+                tempQueue.push_back(queue[index]);
+            }
+        }
+
+        // Rebuild the queue with emergency calls first
+        for (int index = 0; index < tempQueue.size(); ++index) {
+            queue[index] = tempQueue[index];
+        }
+
+        front = 0;
+        rear = tempQueue.size() - 1;
+        finishPrioritize();
+    }
+
+    // Same order as prioritizeEmergencyCalls(), computed as a stable partition
+    // on up to `threadCount` threads. Each thread counts the EMERGENCY calls in
+    // its chunk of the ring, a prefix sum over the counts gives every chunk its
+    // output offsets, and each thread then copies its chunk into the second
+    // ring, which is swapped in. The second ring is kept for the next call
+    // (see `scratch`). Queues too small to give each thread `minCallsPerThread`
+    // calls use fewer threads, down to the serial version, which is also used
+    // if the helper threads cannot all be started.
+    void prioritizeEmergencyCalls(int threadCount, int minCallsPerThread = kMinCallsPerThread) {
+        if (isEmpty()) return;
+
+        int count = size();
+        int chunks = std::clamp(count / std::max(1, minCallsPerThread), 1, std::max(1, threadCount));
+        if (chunks == 1) {
+            prioritizeEmergencyCalls();
+            return;
+        }
+        if (scratch.size() != queue.size()) scratch.resize(queue.size());
+
+        struct Chunk {
+            int first, last;  // logical positions [first, last)
+            int emergencies;
+            int emergencyOut; // where this chunk's EMERGENCY calls go
+            int normalOut;    // where its NORMAL calls go
+        };
+        std::vector<Chunk> parts(chunks);
+        for (int c = 0; c < chunks; ++c) {
+            parts[c].first = static_cast<int>(static_cast<long long>(count) * c / chunks);
+            parts[c].last = static_cast<int>(static_cast<long long>(count) * (c + 1) / chunks);
+        }
+
+        // The last thread to finish counting computes everyone's offsets.
+        std::barrier offsetsReady(chunks, [&parts]() noexcept {
+            int emergencyOut = 0;
+            for (Chunk& part : parts) {
+                part.emergencyOut = emergencyOut;
+                emergencyOut += part.emergencies;
+            }
+            int normalOut = emergencyOut;
+            for (Chunk& part : parts) {
+                part.normalOut = normalOut;
+                normalOut += (part.last - part.first) - part.emergencies;
+            }
+        });
+
+        auto partition = [&](Chunk& part) {
+            int start = (front + part.first) % capacity;
+            int emergencies = 0;
+            for (int i = part.first, index = start; i < part.last; ++i) {
+                emergencies += queue[index].type == CallType::EMERGENCY;
+                if (++index == capacity) index = 0;
+            }
+            part.emergencies = emergencies;
+            offsetsReady.arrive_and_wait();
+
+            int emergencyOut = part.emergencyOut;
+            int normalOut = part.normalOut;
+            for (int i = part.first, index = start; i < part.last; ++i) {
+                const Call& call = queue[index];
+                scratch[call.type == CallType::EMERGENCY ? emergencyOut++ : normalOut++] = call;
+                if (++index == capacity) index = 0;
+            }
+        };
+
+        // Helpers hold off until all of them exist, so a failed spawn can
+        // dismiss the rest before anyone waits at the barrier.
+        std::latch started(1);
+        bool abandoned = false;
+        std::vector<std::thread> helpers;
+        helpers.reserve(chunks - 1);
+        try {
+            for (int c = 1; c < chunks; ++c) {
+                helpers.emplace_back([&, c] {
+                    started.wait();
+                    if (!abandoned) partition(parts[c]);
+                });
+            }
+        }
+        catch (const std::system_error&) {
+            abandoned = true;
+        }
+        started.count_down();
+        if (!abandoned) partition(parts[0]);
+        for (std::thread& helper : helpers) helper.join();
+        if (abandoned) {
+            prioritizeEmergencyCalls();
+            return;
+        }
+
+        queue.swap(scratch);
+        front = 0;
+        rear = count - 1;
+        finishPrioritize();
+    }
+
+    // Frees the second ring kept by the parallel prioritize.
+    void releasePrioritizeBuffer() {
+        std::vector<Call, RingAllocator<Call>>(queue.get_allocator()).swap(scratch);
+    }
+};
+
+static_assert(std::random_access_iterator<CircularQueue::const_iterator>);
+static_assert(std::ranges::random_access_range<const CircularQueue>);
+static_assert(std::ranges::sized_range<const CircularQueue>);
+static_assert(std::ranges::view<decltype(std::declval<const CircularQueue&>().calls())>);
+
+// CRC-32 (IEEE 802.3, reflected) used to detect torn or corrupted log records.
+inline std::uint32_t crc32(const void* data, std::size_t length, std::uint32_t crc = 0) {
+    static const auto table = [] {
+        std::vector<std::uint32_t> t(256);
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (std::size_t i = 0; i < length; ++i) crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Write-ahead log of CircularQueue mutations with group commit.
+//
+// Records are buffered in memory and written + fdatasync'ed as one batch once
+// `groupSize` records are pending or `maxDelayUs` has passed since the first
+// pending record, whichever comes first. The delay is checked when a record
+// arrives and by flushIfDue(), which the owner must call regularly (e.g. from
+// its idle loop) for the delay to bound a tail batch on a queue gone quiet.
+// A crash can therefore lose at most the last uncommitted batch; call sync()
+// where an operation must be durable before it is acknowledged.
+//
+// If a batch fails to write or sync, the file is cut back to the last
+// committed record, so a torn write never hides later records from recovery,
+// and the log fails: it drops further records, sync() and checkpoint()
+// return false, and failed() tells the attached queue to refuse new calls.
+//
+// File layout: a fixed header followed by records of
+//   [u32 payload length][u32 crc32 of payload][payload]
+// where the payload is [u64 sequence][u8 op][op data]. Recovery replays
+// records until the first one that is torn or fails its checksum, and cuts
+// the file there so new records are appended after the last good one.
+class WriteAheadLog : public QueueJournal {
+private:
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t callSize;
+        std::int32_t capacity;
+    };
+
+    static constexpr char kMagic[8] = { 'T', 'Q', 'W', 'A', 'L', '0', '0', '1' };
+    static constexpr std::uint32_t kVersion = 1;
+
+    std::string path;
+    int fd = -1;
+    int capacity;
+    int groupSize;
+    long long maxDelayUs;
+    std::vector<char> buffer;
+    int pending = 0;
+    std::uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point batchStart;
+    long long syncCount = 0;
+    off_t committedBytes = 0; // file length after the last committed batch
+    bool broken = false;
+
+    static FileHeader makeHeader(int capacity) {
+        FileHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.callSize = sizeof(Call);
+        header.capacity = capacity;
+        return header;
+    }
+
+    static bool writeAll(int fd, const char* data, std::size_t length) {
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0) return false;
+            data += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    void append(QueueOp op, const void* data, std::size_t length) {
+        std::uint32_t payloadLength = sizeof(sequence) + 1 + length;
+        std::size_t offset = buffer.size();
+        buffer.resize(offset + 8 + payloadLength);
+        char* payload = buffer.data() + offset + 8;
+        ++sequence;
+        std::memcpy(payload, &sequence, sizeof(sequence));
+        payload[sizeof(sequence)] = static_cast<char>(op);
+        if (length) std::memcpy(payload + sizeof(sequence) + 1, data, length);
+        std::uint32_t crc = crc32(payload, payloadLength);
+        std::memcpy(buffer.data() + offset, &payloadLength, 4);
+        std::memcpy(buffer.data() + offset + 4, &crc, 4);
+    }
+
+    void appendCheckpoint(const CircularQueue& cq) {
+        std::vector<char> data(3 * sizeof(std::int32_t) + cq.size() * sizeof(Call));
+        std::int32_t state[3] = { cq.front, cq.rear, cq.size() };
+        std::memcpy(data.data(), state, sizeof(state));
+        char* out = data.data() + sizeof(state);
+        for (int i = 0, index = cq.front; i < state[2]; ++i, index = (index + 1) % cq.capacity) {
+            std::memcpy(out, &cq.queue[index], sizeof(Call));
+            out += sizeof(Call);
+        }
+        append(QueueOp::CHECKPOINT, data.data(), data.size());
+    }
+
+public:
+    WriteAheadLog(const std::string& logPath, int queueCapacity, int groupCommitSize = 64, long long groupCommitDelayUs = 1000)
+        : path(logPath), capacity(queueCapacity), groupSize(groupCommitSize > 0 ? groupCommitSize : 1),
+          maxDelayUs(groupCommitDelayUs) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            std::cerr << "WriteAheadLog: cannot open " << path << "\n";
+            return;
+        }
+        committedBytes = ::lseek(fd, 0, SEEK_END);
+        if (committedBytes == 0) {
+            FileHeader header = makeHeader(capacity);
+            broken = !writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) || ::fdatasync(fd) != 0;
+            committedBytes = broken ? 0 : sizeof(header);
+        }
+        if (broken) std::cerr << "WriteAheadLog: cannot write " << path << "\n";
+    }
+
+    ~WriteAheadLog() {
+        if (fd >= 0) {
+            sync();
+            ::close(fd);
+        }
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    long long getSyncCount() const { return syncCount; }
+    bool failed() const override { return fd < 0 || broken; }
+
+    void record(QueueOp op, const Call* call) override {
+        if (failed()) return;
+        if (pending == 0 && maxDelayUs > 0) batchStart = std::chrono::steady_clock::now();
+        append(op, call, call ? sizeof(Call) : 0);
+        if (++pending >= groupSize) {
+            sync();
+        }
+        else {
+            flushIfDue();
+        }
+    }
+
+    // Commits the pending batch once its first record is `maxDelayUs` old.
+    // Returns true if it synced.
+    bool flushIfDue() {
+        if (pending == 0 || maxDelayUs <= 0) return false;
+        if (std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - batchStart).count() < maxDelayUs) {
+            return false;
+        }
+        sync();
+        return true;
+    }
+
+    // Writes and fdatasyncs every pending record as a single group commit.
+    // On failure the batch is dropped, the file is cut back to the last
+    // committed record and the log fails.
+    bool sync() {
+        if (failed()) return false;
+        if (buffer.empty()) return true;
+        bool ok = writeAll(fd, buffer.data(), buffer.size()) && ::fdatasync(fd) == 0;
+        if (ok) {
+            committedBytes += buffer.size();
+            ++syncCount;
+        }
+        else {
+            if (::ftruncate(fd, committedBytes) == 0) ::fdatasync(fd);
+            broken = true;
+            std::cerr << "WriteAheadLog: cannot commit to " << path << "\n";
+        }
+        buffer.clear();
+        pending = 0;
+        return ok;
+    }
+
+    // Compacts the log to a single snapshot of the queue. The snapshot is
+    // written to a side file which atomically replaces the log, so a crash
+    // leaves either the old log or the new one.
+    bool checkpoint(const CircularQueue& cq) {
+        if (!sync()) return false;
+        std::string tmpPath = path + ".tmp";
+        int tmp = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (tmp < 0) return false;
+        FileHeader header = makeHeader(capacity);
+        appendCheckpoint(cq);
+        bool ok = writeAll(tmp, reinterpret_cast<const char*>(&header), sizeof(header))
+            && writeAll(tmp, buffer.data(), buffer.size()) && ::fsync(tmp) == 0;
+        off_t checkpointBytes = sizeof(header) + buffer.size();
+        buffer.clear();
+        pending = 0;
+        ::close(tmp);
+        if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        // The rename is only durable once the directory entry is.
+        std::string::size_type slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        ok = dir >= 0 && ::fsync(dir) == 0;
+        if (dir >= 0) ::close(dir);
+        ::close(fd);
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        committedBytes = checkpointBytes;
+        return ok && fd >= 0;
+    }
+
+    // Rebuilds `cq` from the log at `logPath`, reproducing the exact front/rear
+    // positions the queue had after the last committed record. Returns the
+    // number of records applied, or -1 if the log is missing or was written
+    // for a different queue capacity or Call layout.
+    static long long recover(const std::string& logPath, CircularQueue& cq) {
+        int in = ::open(logPath.c_str(), O_RDWR);
+        if (in < 0) return -1;
+        std::vector<char> data;
+        char chunk[1 << 16];
+        for (ssize_t n; (n = ::read(in, chunk, sizeof(chunk))) > 0;) data.insert(data.end(), chunk, chunk + n);
+
+        FileHeader header;
+        if (data.size() < sizeof(header)) {
+            ::close(in);
+            return -1;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+            || header.callSize != sizeof(Call) || header.capacity != cq.capacity) {
+            ::close(in);
+            return -1;
+        }
+
+        QueueJournal* savedJournal = cq.journal;
+        QueueMetrics* savedMetrics = cq.metrics;
+        WaitTimeRecorder* savedRecorder = cq.waitRecorder;
+        WaitEstimator* savedEstimator = cq.estimator;
+        QueuePositionIndex* savedPositions = cq.positions;
+        bool savedVerbose = cq.verbose;
+        cq.attachMetrics(nullptr);
+        cq.attachWaitEstimator(nullptr);
+        cq.attachPositionIndex(nullptr);
+        cq.journal = nullptr;
+        cq.waitRecorder = nullptr;
+        cq.verbose = false;
+        cq.front = cq.rear = -1;
+        cq.depthByType[0] = cq.depthByType[1] = 0;
+        cq.callers.clear();
+
+        long long applied = 0;
+        std::size_t offset = sizeof(header);
+        while (offset + 8 <= data.size()) {
+            std::uint32_t length, crc;
+            std::memcpy(&length, data.data() + offset, 4);
+            std::memcpy(&crc, data.data() + offset + 4, 4);
+            if (length < sizeof(std::uint64_t) + 1 || offset + 8 + length > data.size()) break;
+            const char* payload = data.data() + offset + 8;
+            if (crc32(payload, length) != crc) break;
+
+            QueueOp op = static_cast<QueueOp>(payload[sizeof(std::uint64_t)]);
+            const char* body = payload + sizeof(std::uint64_t) + 1;
+            std::size_t bodyLength = length - sizeof(std::uint64_t) - 1;
+            Call call;
+            if (op == QueueOp::ENQUEUE && bodyLength == sizeof(Call)) {
+                std::memcpy(&call, body, sizeof(Call));
+                call.caller = {}; // the log holds handles, not the strings behind them
+                cq.enqueue(call);
+            }
+            else if (op == QueueOp::DEQUEUE) {
+                cq.dequeue(call);
+            }
+            else if (op == QueueOp::PRIORITIZE) {
+                cq.prioritizeEmergencyCalls();
+            }
+            else if (op == QueueOp::CANCEL && bodyLength == sizeof(Call)) {
+                std::memcpy(&call, body, sizeof(Call));
+                cq.cancel(call.callId);
+            }
+            else if (op == QueueOp::REMOVE_NEWEST) {
+                cq.removeNewest(call);
+            }
+            else if (op == QueueOp::CHECKPOINT && bodyLength >= 3 * sizeof(std::int32_t)) {
+                std::int32_t state[3];
+                std::memcpy(state, body, sizeof(state));
+                body += sizeof(state);
+                // A snapshot that does not describe a ring of this capacity is corrupt.
+                bool validRing = state[2] == 0 ? state[0] == -1 && state[1] == -1
+                    : state[2] > 0 && state[2] <= cq.capacity && state[0] >= 0 && state[0] < cq.capacity
+                        && state[1] == (state[0] + state[2] - 1) % cq.capacity;
+                if (!validRing || bodyLength != sizeof(state) + static_cast<std::size_t>(state[2]) * sizeof(Call)) break;
+                for (int i = 0, index = state[0]; i < state[2]; ++i, index = (index + 1) % cq.capacity) {
+                    std::memcpy(&cq.queue[index], body, sizeof(Call));
+                    cq.queue[index].caller = {};
+                    body += sizeof(Call);
+                }
+                cq.front = state[0];
+                cq.rear = state[1];
+                cq.depthByType[0] = cq.depthByType[1] = 0;
+                for (int i = 0, index = state[0]; i < state[2]; ++i, index = (index + 1) % cq.capacity) {
+                    ++cq.depthByType[static_cast<int>(cq.queue[index].type)];
+                }
+            }
+            else {
+                break;
+            }
+            ++applied;
+            offset += 8 + length;
+        }
+        if (offset < data.size() && ::ftruncate(in, offset) == 0) ::fsync(in);
+        ::close(in);
+
+        cq.journal = savedJournal;
+        cq.waitRecorder = savedRecorder;
+        cq.verbose = savedVerbose;
+        cq.attachMetrics(savedMetrics);
+        cq.attachWaitEstimator(savedEstimator);
+        cq.attachPositionIndex(savedPositions);
+        return applied;
+    }
+};
+
+// Circular queue whose ring lives in a memory-mapped file, so a restarted
+// process can reattach and resume with the queue intact.
+//
+// File layout: one header page, then two banks of `capacity` Call slots.
+// Enqueue/dequeue work in the active bank; prioritizeEmergencyCalls writes the
+// reordered calls into the other bank and switches banks when it publishes.
+// The header keeps two copies of the ring state (front, rear, bank), each with
+// a sequence number and checksum. Every update first writes the slots it needs,
+// then writes the older state copy with the next sequence number. A crash at
+// any point therefore leaves at least one valid state copy that only refers to
+// fully written slots; attach picks the valid copy with the highest sequence.
+//
+// The ordering survives a crash of the process, since the mapping stays in the
+// page cache. Call sync() to also flush it to disk against power loss.
+class PersistentCircularQueue {
+private:
+    struct RingState {
+        std::uint64_t sequence;
+        std::int64_t front;
+        std::int64_t rear;
+        std::uint32_t bank;
+        std::uint32_t checksum;
+    };
+
+    struct RingHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t callSize;
+        std::int64_t capacity;
+        std::uint32_t checksum;
+        std::uint32_t reserved;
+        RingState states[2];
+    };
+
+    static constexpr char kMagic[8] = { 'T', 'Q', 'R', 'I', 'N', 'G', '0', '1' };
+    static constexpr std::uint32_t kVersion = 1;
+    static constexpr std::size_t kHeaderSize = 4096;
+
+    int fd = -1;
+    char* base = nullptr;
+    std::size_t mappedSize = 0;
+    RingHeader* header = nullptr;
+    Call* banks[2] = { nullptr, nullptr };
+    std::int64_t capacity = 0;
+    std::int64_t front = -1, rear = -1;
+    std::uint32_t bank = 0;
+    std::uint64_t sequence = 0;
+    bool recovered = false;
+    bool verbose = true;
+
+    static std::uint32_t stateChecksum(const RingState& state) {
+        return crc32(&state, offsetof(RingState, checksum));
+    }
+
+    static std::uint32_t headerChecksum(const RingHeader& h) {
+        return crc32(&h, offsetof(RingHeader, checksum));
+    }
+
+    // Publishes front/rear/bank by overwriting the older of the two state copies.
+    void publish() {
+        std::atomic_thread_fence(std::memory_order_release);
+        ++sequence;
+        RingState& target = header->states[sequence & 1];
+        RingState state{};
+        state.sequence = sequence;
+        state.front = front;
+        state.rear = rear;
+        state.bank = bank;
+        state.checksum = stateChecksum(state);
+        target = state;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    bool loadState() {
+        const RingState* best = nullptr;
+        for (const RingState& state : header->states) {
+            if (state.checksum != stateChecksum(state) || state.bank > 1) continue;
+            if (state.front < -1 || state.front >= capacity || state.rear < -1 || state.rear >= capacity) continue;
+            if (!best || state.sequence > best->sequence) best = &state;
+        }
+        if (!best) return false;
+        sequence = best->sequence;
+        front = best->front;
+        rear = best->rear;
+        bank = best->bank;
+        return true;
+    }
+
+public:
+    // Attaches to the ring in `path` if it holds a valid ring of `size` slots,
+    // otherwise creates a new empty ring there. A ring written with another
+    // capacity or Call layout is left untouched and the queue stays closed
+    // (isOpen() is false), so its calls are never overwritten.
+    PersistentCircularQueue(const std::string& path, std::int64_t size) : capacity(size) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0 || size <= 0) {
+            std::cerr << "PersistentCircularQueue: cannot open " << path << "\n";
+            return;
+        }
+        RingHeader onDisk{};
+        if (::pread(fd, &onDisk, sizeof(onDisk), 0) == static_cast<ssize_t>(sizeof(onDisk))
+            && std::memcmp(onDisk.magic, kMagic, sizeof(kMagic)) == 0 && onDisk.checksum == headerChecksum(onDisk)
+            && (onDisk.capacity != size || onDisk.callSize != sizeof(Call))) {
+            std::cerr << "PersistentCircularQueue: " << path << " holds a ring of " << onDisk.capacity
+                << " slots of " << onDisk.callSize << " bytes\n";
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+        mappedSize = kHeaderSize + 2 * static_cast<std::size_t>(size) * sizeof(Call);
+        struct stat st;
+        bool existing = ::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) == mappedSize;
+        if (!existing && ::ftruncate(fd, 0) != 0) return;
+        if (!existing && ::ftruncate(fd, mappedSize) != 0) return;
+
+        void* mapping = ::mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "PersistentCircularQueue: cannot map " << path << "\n";
+            return;
+        }
+        base = static_cast<char*>(mapping);
+        header = reinterpret_cast<RingHeader*>(base);
+        banks[0] = reinterpret_cast<Call*>(base + kHeaderSize);
+        banks[1] = banks[0] + size;
+
+        recovered = existing && std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0
+            && header->version == kVersion && header->callSize == sizeof(Call)
+            && header->capacity == size && header->checksum == headerChecksum(*header) && loadState();
+        if (!recovered) {
+            std::memset(header, 0, sizeof(RingHeader));
+            std::memcpy(header->magic, kMagic, sizeof(kMagic));
+            header->version = kVersion;
+            header->callSize = sizeof(Call);
+            header->capacity = size;
+            header->checksum = headerChecksum(*header);
+            front = rear = -1;
+            bank = 0;
+            sequence = 0;
+            publish();
+        }
+    }
+
+    ~PersistentCircularQueue() {
+        if (base) ::munmap(base, mappedSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    PersistentCircularQueue(const PersistentCircularQueue&) = delete;
+    PersistentCircularQueue& operator=(const PersistentCircularQueue&) = delete;
+
+    bool isOpen() const { return base != nullptr; }
+
+    // True when the constructor reattached to an existing ring.
+    bool wasRecovered() const { return recovered; }
+
+    void setVerbose(bool enabled) { verbose = enabled; }
+
+    std::int64_t getCapacity() const { return capacity; }
+
+    std::int64_t size() const {
+        if (front == -1) return 0;
+        return (rear - front + capacity) % capacity + 1;
+    }
+
+    bool isFull() const {
+        return ((rear + 1) % capacity == front);
+    }
+
+    bool isEmpty() const {
+        return (front == -1);
+    }
+
+    bool enqueue(const Call& call) {
+        if (isFull()) {
+            if (verbose) std::cout << "Queue Overflow! Cannot enqueue call.\n";
+            return false;
+        }
+        std::int64_t slot = (rear + 1) % capacity;
+        banks[bank][slot] = call;
+        if (front == -1) front = 0;
+        rear = slot;
+        publish();
+        if (verbose) std::cout << "Enqueued Call ID: " << call.callId << "\n";
+        return true;
+    }
+
+    bool dequeue() {
+        Call call;
+        return dequeue(call);
+    }
+
+    bool dequeue(Call& out) {
+        if (isEmpty()) {
+            if (verbose) std::cout << "Queue Underflow! Cannot dequeue call.\n";
+            return false;
+        }
+        out = banks[bank][front];
+        out.caller = {}; // handles name strings in the arena of whichever process wrote the slot
+        if (verbose) std::cout << "Dequeued Call ID: " << out.callId << "\n";
+        if (front == rear) {
+            front = rear = -1; // Reset queue
+        }
+        else {
+            front = (front + 1) % capacity;
+        }
+        publish();
+        return true;
+    }
+
+    void display() const {
+        if (isEmpty()) {
+            std::cout << "Queue is empty.\n";
+            return;
+        }
+        const Call* slots = banks[bank];
+        std::int64_t index = front;
+        do {
+            std::cout << "Call ID: " << slots[index].callId
+                << ", Type: " << (slots[index].type == CallType::NORMAL ? "NORMAL" : "EMERGENCY")
+                << ", Duration: " << slots[index].duration
+                << ", Callback Requested: " << (slots[index].callbackRequested ? "Yes" : "No")
+                << "\n";
+            index = (index + 1) % capacity;
+        } while (index != (rear + 1) % capacity);
+    }
+
+    void prioritizeEmergencyCalls() {
+        if (isEmpty()) return;
+        const Call* from = banks[bank];
+        Call* to = banks[bank ^ 1];
+        std::int64_t count = size(), written = 0;
+        for (std::int64_t i = 0, index = front; i < count; ++i, index = (index + 1) % capacity) {
+            if (from[index].type == CallType::EMERGENCY) to[written++] = from[index];
+        }
+        for (std::int64_t i = 0, index = front; i < count; ++i, index = (index + 1) % capacity) {
+            if (from[index].type == CallType::NORMAL) to[written++] = from[index];
+        }
+        bank ^= 1;
+        front = 0;
+        rear = written - 1;
+        publish();
+    }
+
+    // Flushes the ring to disk: slots first, then the header that refers to them.
+    bool sync() {
+        if (!base) return false;
+        return ::msync(base + kHeaderSize, mappedSize - kHeaderSize, MS_SYNC) == 0
+            && ::msync(base, kHeaderSize, MS_SYNC) == 0;
+    }
+};
+
+// Single-producer/single-consumer call queue in a POSIX shared-memory segment,
+// for handing calls from one process to another without copying them through
+// a socket.
+//
+// head (next slot to read) and tail (next slot to write) are free-running
+// 64-bit counters, kept on separate cache lines as process-shared atomics;
+// capacity is rounded up to a power of two so a counter maps to its slot with
+// a mask. enqueue and dequeue never make a system call. A consumer that finds
+// the queue empty may sleep in waitDequeue on an eventfd; it raises a flag in
+// the segment first and rechecks the queue, and the producer writes the
+// eventfd only when it sees that flag after publishing a call.
+//
+// The eventfd is inherited across fork(). Unrelated processes can pass it with
+// sendWakeupDescriptor/receiveWakeupDescriptor over a Unix-domain socket.
+class SharedCallQueue {
+private:
+    struct alignas(64) Segment {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t callSize;
+        std::uint64_t capacity;
+        alignas(64) std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint64_t> tail;
+        alignas(64) std::atomic<std::uint32_t> consumerSleeping;
+    };
+
+    static constexpr char kMagic[8] = { 'T', 'Q', 'S', 'H', 'M', 'Q', '0', '1' };
+    static constexpr std::uint32_t kVersion = 1;
+
+    std::string name;
+    Segment* segment = nullptr;
+    Call* slots = nullptr;
+    std::size_t mappedSize = 0;
+    std::uint64_t mask = 0;
+    int wakeupFd = -1;
+    bool owner = false;
+    // Private to each side: the last value seen of the other side's counter.
+    std::uint64_t cachedHead = 0;
+    std::uint64_t cachedTail = 0;
+
+    static std::size_t segmentSize(std::uint64_t capacity) {
+        return sizeof(Segment) + capacity * sizeof(Call);
+    }
+
+    bool map(int fd, std::size_t length) {
+        void* mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+        mappedSize = length;
+        segment = static_cast<Segment*>(mapping);
+        slots = reinterpret_cast<Call*>(segment + 1);
+        return true;
+    }
+
+public:
+    // Creates the segment `segmentName` (e.g. "/telephone_calls") holding at
+    // least `size` calls, replacing any stale segment of the same name.
+    SharedCallQueue(const std::string& segmentName, std::uint64_t size) : name(segmentName), owner(true) {
+        std::uint64_t capacity = 1;
+        while (capacity < size) capacity <<= 1;
+        ::shm_unlink(name.c_str());
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 || ::ftruncate(fd, segmentSize(capacity)) != 0 || !map(fd, segmentSize(capacity))) {
+            std::cerr << "SharedCallQueue: cannot create " << name << "\n";
+            segment = nullptr;
+            return;
+        }
+        new (segment) Segment();
+        std::memcpy(segment->magic, kMagic, sizeof(kMagic));
+        segment->version = kVersion;
+        segment->callSize = sizeof(Call);
+        segment->capacity = capacity;
+        mask = capacity - 1;
+        wakeupFd = ::eventfd(0, 0);
+    }
+
+    // Attaches to a segment created by another process. Blocking waits need
+    // the wakeup descriptor from receiveWakeupDescriptor().
+    explicit SharedCallQueue(const std::string& segmentName) : name(segmentName) {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Segment)
+            || !map(fd, st.st_size)) {
+            std::cerr << "SharedCallQueue: cannot attach " << name << "\n";
+            segment = nullptr;
+            return;
+        }
+        if (std::memcmp(segment->magic, kMagic, sizeof(kMagic)) != 0 || segment->version != kVersion
+            || segment->callSize != sizeof(Call) || segmentSize(segment->capacity) != mappedSize) {
+            std::cerr << "SharedCallQueue: " << name << " has an incompatible layout\n";
+            ::munmap(segment, mappedSize);
+            segment = nullptr;
+            return;
+        }
+        mask = segment->capacity - 1;
+        cachedHead = segment->head.load(std::memory_order_acquire);
+        cachedTail = segment->tail.load(std::memory_order_acquire);
+    }
+
+    ~SharedCallQueue() {
+        if (segment) ::munmap(segment, mappedSize);
+        if (wakeupFd >= 0) ::close(wakeupFd);
+    }
+
+    SharedCallQueue(const SharedCallQueue&) = delete;
+    SharedCallQueue& operator=(const SharedCallQueue&) = delete;
+
+    bool isOpen() const { return segment != nullptr; }
+
+    std::uint64_t getCapacity() const { return segment->capacity; }
+
+    std::uint64_t size() const {
+        return segment->tail.load(std::memory_order_acquire) - segment->head.load(std::memory_order_acquire);
+    }
+
+    bool isEmpty() const { return size() == 0; }
+
+    bool isFull() const { return size() == segment->capacity; }
+
+    // Producer side.
+    bool enqueue(const Call& call) {
+        std::uint64_t tail = segment->tail.load(std::memory_order_relaxed);
+        if (tail - cachedHead == segment->capacity) {
+            cachedHead = segment->head.load(std::memory_order_acquire);
+            if (tail - cachedHead == segment->capacity) return false;
+        }
+        slots[tail & mask] = call;
+        segment->tail.store(tail + 1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (segment->consumerSleeping.load(std::memory_order_relaxed)) {
+            segment->consumerSleeping.store(0, std::memory_order_relaxed);
+            std::uint64_t one = 1;
+            if (wakeupFd >= 0) (void)::write(wakeupFd, &one, sizeof(one));
+        }
+        return true;
+    }
+
+    // Consumer side. Returns false without waiting when the queue is empty.
+    bool dequeue(Call& out) {
+        std::uint64_t head = segment->head.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = segment->tail.load(std::memory_order_acquire);
+            if (head == cachedTail) return false;
+        }
+        out = slots[head & mask];
+        out.caller = {}; // handles name strings in the producer's arena
+        segment->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Spins `spinLimit` times, then sleeps on the eventfd until
+    // a call arrives or `timeoutMs` passes (-1 waits forever).
+    bool waitDequeue(Call& out, int timeoutMs = -1, int spinLimit = 1000) {
+        for (int spin = 0; spin < spinLimit; ++spin) {
+            if (dequeue(out)) return true;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            segment->consumerSleeping.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (dequeue(out)) {
+                segment->consumerSleeping.store(0, std::memory_order_relaxed);
+                return true;
+            }
+            int waitMs = -1;
+            if (timeoutMs >= 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0) {
+                    segment->consumerSleeping.store(0, std::memory_order_relaxed);
+                    return false;
+                }
+                waitMs = static_cast<int>(left.count());
+            }
+            if (wakeupFd < 0) {
+                // No descriptor to sleep on: nap briefly and look again.
+                ::poll(nullptr, 0, waitMs < 0 || waitMs > 1 ? 1 : waitMs);
+                continue;
+            }
+            struct pollfd pfd = { wakeupFd, POLLIN, 0 };
+            if (::poll(&pfd, 1, waitMs) > 0) {
+                std::uint64_t count;
+                (void)::read(wakeupFd, &count, sizeof(count));
+            }
+        }
+    }
+
+    // Passes the wakeup eventfd to the process at the other end of `socketFd`.
+    bool sendWakeupDescriptor(int socketFd) const {
+        char byte = 0;
+        struct iovec iov = { &byte, 1 };
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &wakeupFd, sizeof(int));
+        return ::sendmsg(socketFd, &msg, 0) == 1;
+    }
+
+    bool receiveWakeupDescriptor(int socketFd) {
+        char byte;
+        struct iovec iov = { &byte, 1 };
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(socketFd, &msg, 0) != 1) return false;
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS) return false;
+        if (wakeupFd >= 0) ::close(wakeupFd);
+        std::memcpy(&wakeupFd, CMSG_DATA(cmsg), sizeof(int));
+        return true;
+    }
+
+    // Removes the segment name; processes already attached keep their mapping.
+    void unlink() {
+        if (owner) ::shm_unlink(name.c_str());
+    }
+};
+
+// Replication stream between a ReplicationLeader and a ReplicationFollower.
+// Operations are shipped in frames of
+//   [ReplicationFrame][op records...]
+// where each record is [u8 op] followed by the Call for ENQUEUE, the callId
+// for DEQUEUE, CANCEL and REMOVE_NEWEST, and nothing for PRIORITIZE. The
+// follower answers every frame with the u64 sequence number of the last
+// operation it applied. A frame longer than kMaxReplicationFrameBytes, or whose
+// payload is not exactly `count` records, is treated as divergence.
+struct ReplicationFrame {
+    std::uint32_t length;        // bytes of op records after this header
+    std::uint32_t count;         // op records in the frame
+    std::uint64_t firstSequence; // sequence number of the first record
+    std::int64_t firstRecordNs;  // nowNanos() when the first record was made
+    std::uint32_t flags;
+    std::uint32_t reserved;
+};
+
+static constexpr std::uint32_t kReplicationHandoff = 1;
+// Largest op-record payload of one frame; a follower treats a longer frame as
+// a corrupt stream.
+static constexpr std::uint32_t kMaxReplicationFrameBytes = 1 << 24;
+
+inline bool sendAll(int fd, const void* data, std::size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t sent = ::send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        bytes += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+inline bool receiveAll(int fd, void* data, std::size_t length) {
+    char* bytes = static_cast<char*>(data);
+    while (length > 0) {
+        ssize_t received = ::recv(fd, bytes, length, 0);
+        if (received <= 0) return false;
+        bytes += received;
+        length -= received;
+    }
+    return true;
+}
+
+// Ships every operation of the queue it is attached to over a connected
+// stream socket to a warm standby.
+//
+// Operations are batched into a frame until it holds `maxBatchBytes` or its
+// first operation is `maxDelayUs` old. Acknowledgements are pipelined: frames
+// are sent without waiting for the standby, and the leader only blocks when
+// more than `maxUnacked` operations are still unacknowledged. Call poll()
+// regularly when the queue is idle so a partial batch is not held back.
+class ReplicationLeader : public QueueJournal {
+private:
+    int socketFd;
+    std::size_t maxBatchBytes;
+    std::int64_t maxDelayNs;
+    std::uint64_t maxUnacked;
+    std::vector<char> batch;
+    ReplicationFrame frame{};
+    std::uint64_t nextSequence = 1;
+    std::uint64_t ackedSequence = 0;
+    char ackBuffer[sizeof(std::uint64_t)];
+    std::size_t ackBytes = 0;
+    bool connected = true;
+
+    void readAcks(bool block) {
+        while (connected) {
+            ssize_t received = ::recv(socketFd, ackBuffer + ackBytes, sizeof(ackBuffer) - ackBytes,
+                block ? 0 : MSG_DONTWAIT);
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                connected = false;
+                return;
+            }
+            if (received < 0) return;
+            ackBytes += received;
+            if (ackBytes == sizeof(ackBuffer)) {
+                std::memcpy(&ackedSequence, ackBuffer, sizeof(ackedSequence));
+                ackBytes = 0;
+                if (block) return;
+            }
+        }
+    }
+
+    void send(std::uint32_t flags) {
+        frame.length = static_cast<std::uint32_t>(batch.size());
+        frame.flags = flags;
+        if (!sendAll(socketFd, &frame, sizeof(frame)) || !sendAll(socketFd, batch.data(), batch.size())) {
+            connected = false;
+        }
+        batch.clear();
+        frame.count = 0;
+    }
+
+public:
+    ReplicationLeader(int connectedSocket, std::size_t batchBytes = 16 * 1024, long long delayUs = 200,
+                      std::uint64_t unackedLimit = 1 << 20)
+        : socketFd(connectedSocket), maxBatchBytes(std::min<std::size_t>(batchBytes, kMaxReplicationFrameBytes - sizeof(Call) - 1)),
+          maxDelayNs(delayUs * 1000), maxUnacked(unackedLimit) {
+        batch.reserve(maxBatchBytes + sizeof(Call) + 1);
+    }
+
+    bool isConnected() const { return connected; }
+    std::uint64_t lastSequence() const { return nextSequence - 1; }
+    std::uint64_t acknowledgedSequence() const { return ackedSequence; }
+
+    void record(QueueOp op, const Call* call) override {
+        if (frame.count == 0) {
+            frame.firstSequence = nextSequence;
+            frame.firstRecordNs = nowNanos();
+        }
+        batch.push_back(static_cast<char>(op));
+        if (op == QueueOp::ENQUEUE) {
+            const char* bytes = reinterpret_cast<const char*>(call);
+            batch.insert(batch.end(), bytes, bytes + sizeof(Call));
+        }
+        else if (op == QueueOp::DEQUEUE || op == QueueOp::CANCEL || op == QueueOp::REMOVE_NEWEST) {
+            const char* bytes = reinterpret_cast<const char*>(&call->callId);
+            batch.insert(batch.end(), bytes, bytes + sizeof(call->callId));
+        }
+        ++frame.count;
+        ++nextSequence;
+        if (batch.size() >= maxBatchBytes) flush();
+    }
+
+    // Sends the pending batch, if any, and collects acknowledgements.
+    void flush() {
+        if (frame.count > 0 && connected) send(0);
+        readAcks(false);
+        while (connected && lastSequence() - ackedSequence > maxUnacked) readAcks(true);
+    }
+
+    // Flushes the pending batch once it is older than the batching delay.
+    void poll() {
+        if (frame.count > 0 && nowNanos() - frame.firstRecordNs >= maxDelayNs) flush();
+        else readAcks(false);
+    }
+
+    // Planned failover: ships everything, tells the standby to take over and
+    // waits until it has acknowledged every operation.
+    bool handoff() {
+        flush();
+        if (!connected) return false;
+        frame.firstSequence = nextSequence;
+        frame.firstRecordNs = nowNanos();
+        send(kReplicationHandoff);
+        while (connected && ackedSequence < lastSequence()) readAcks(true);
+        return ackedSequence == lastSequence();
+    }
+};
+
+// Applies a leader's operation stream to a standby CircularQueue.
+//
+// Promotion: run() returns when the leader hands off or its connection drops.
+// A frame cut short by the drop is discarded, so the replica holds exactly the
+// operations up to the last complete frame. promote() then closes the stream
+// and the replica can serve calls, and attach its own journal, as the new
+// leader.
+class ReplicationFollower {
+private:
+    int socketFd;
+    CircularQueue& replica;
+    std::vector<char> records;
+    std::uint64_t appliedSequence = 0;
+    std::int64_t lastLagNs = 0;
+    bool handedOff = false;
+    bool diverged = false;
+
+    // True if the frame's payload is exactly `count` complete op records.
+    static bool wellFormed(const char* next, const char* end, std::uint32_t count) {
+        for (std::uint32_t i = 0; i < count; ++i) {
+            if (next == end) return false;
+            QueueOp op = static_cast<QueueOp>(*next++);
+            std::size_t size;
+            if (op == QueueOp::ENQUEUE) size = sizeof(Call);
+            else if (op == QueueOp::DEQUEUE || op == QueueOp::CANCEL || op == QueueOp::REMOVE_NEWEST) size = sizeof(int);
+            else if (op == QueueOp::PRIORITIZE) size = 0;
+            else return false;
+            if (static_cast<std::size_t>(end - next) < size) return false;
+            next += size;
+        }
+        return next == end;
+    }
+
+public:
+    ReplicationFollower(int connectedSocket, CircularQueue& standby) : socketFd(connectedSocket), replica(standby) {}
+
+    std::uint64_t lastApplied() const { return appliedSequence; }
+    // Age of the oldest operation in the last frame when it was applied.
+    std::int64_t lastFrameLagNs() const { return lastLagNs; }
+    bool wasHandedOff() const { return handedOff; }
+    bool hasDiverged() const { return diverged; }
+
+    // Applies one frame. Returns false once the stream has ended.
+    bool applyNextBatch() {
+        ReplicationFrame frame;
+        if (handedOff || diverged || socketFd < 0 || !receiveAll(socketFd, &frame, sizeof(frame))) return false;
+        if (frame.length > kMaxReplicationFrameBytes) {
+            diverged = true;
+            return false;
+        }
+        records.resize(frame.length);
+        if (!receiveAll(socketFd, records.data(), records.size())) return false;
+        const char* next = records.data();
+        const char* end = next + records.size();
+        if ((frame.count > 0 && frame.firstSequence != appliedSequence + 1) || !wellFormed(next, end, frame.count)) {
+            diverged = true;
+            return false;
+        }
+
+        for (std::uint32_t i = 0; i < frame.count; ++i) {
+            QueueOp op = static_cast<QueueOp>(*next++);
+            Call call;
+            int callId;
+            if (op == QueueOp::ENQUEUE) {
+                std::memcpy(&call, next, sizeof(Call));
+                next += sizeof(Call);
+                call.caller = {}; // handles name strings in the leader's arena
+                replica.enqueue(call);
+            }
+            else if (op == QueueOp::DEQUEUE) {
+                std::memcpy(&callId, next, sizeof(callId));
+                next += sizeof(callId);
+                if (!replica.dequeue(call) || call.callId != callId) diverged = true;
+            }
+            else if (op == QueueOp::CANCEL) {
+                std::memcpy(&callId, next, sizeof(callId));
+                next += sizeof(callId);
+                if (!replica.cancel(callId)) diverged = true;
+            }
+            else if (op == QueueOp::REMOVE_NEWEST) {
+                std::memcpy(&callId, next, sizeof(callId));
+                next += sizeof(callId);
+                if (!replica.removeNewest(call) || call.callId != callId) diverged = true;
+            }
+            else if (op == QueueOp::PRIORITIZE) {
+                replica.prioritizeEmergencyCalls();
+            }
+            else {
+                diverged = true;
+            }
+            if (diverged) return false;
+            ++appliedSequence;
+        }
+        lastLagNs = nowNanos() - frame.firstRecordNs;
+        if (frame.flags & kReplicationHandoff) handedOff = true;
+        return sendAll(socketFd, &appliedSequence, sizeof(appliedSequence)) && !handedOff;
+    }
+
+    void run() {
+        while (applyNextBatch()) {}
+    }
+
+    // Stops following. Returns the sequence number the replica is at.
+    std::uint64_t promote() {
+        if (socketFd >= 0) ::close(socketFd);
+        socketFd = -1;
+        return appliedSequence;
+    }
+};
+
+// One operation of a recorded call trace. Trace files are a TraceFileHeader
+// followed by these fixed-size records in time order.
+struct TraceRecord {
+    std::int64_t timestampNs; // since the start of the trace
+    QueueOp op;               // ENQUEUE, DEQUEUE or PRIORITIZE
+    CallType type;
+    bool callbackRequested;
+    std::int32_t callId;
+    std::int32_t duration;
+};
+
+struct TraceFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+};
+
+static constexpr char kTraceMagic[8] = { 'T', 'Q', 'T', 'R', 'A', 'C', 'E', '1' };
+static constexpr std::uint32_t kTraceVersion = 1;
+
+// Writes a trace file. Attached to a CircularQueue as its journal it captures
+// the queue's live operations with their timing.
+class TraceWriter : public QueueJournal {
+private:
+    FILE* file = nullptr;
+    std::int64_t startNs;
+    long long written = 0;
+
+public:
+    explicit TraceWriter(const std::string& path) : startNs(nowNanos()) {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "TraceWriter: cannot open " << path << "\n";
+            return;
+        }
+        TraceFileHeader header{};
+        std::memcpy(header.magic, kTraceMagic, sizeof(kTraceMagic));
+        header.version = kTraceVersion;
+        header.recordSize = sizeof(TraceRecord);
+        std::fwrite(&header, sizeof(header), 1, file);
+    }
+
+    ~TraceWriter() {
+        if (file) std::fclose(file);
+    }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+    long long recordCount() const { return written; }
+
+    bool write(const TraceRecord& record) {
+        if (!file || std::fwrite(&record, sizeof(record), 1, file) != 1) return false;
+        ++written;
+        return true;
+    }
+
+    void record(QueueOp op, const Call* call) override {
+        if (op != QueueOp::ENQUEUE && op != QueueOp::DEQUEUE && op != QueueOp::PRIORITIZE) return;
+        TraceRecord record{};
+        record.timestampNs = nowNanos() - startNs;
+        record.op = op;
+        if (op == QueueOp::ENQUEUE) {
+            record.type = call->type;
+            record.callbackRequested = call->callbackRequested;
+            record.callId = call->callId;
+            record.duration = call->duration;
+        }
+        write(record);
+    }
+};
+
+// Reads a whole trace file. Fails, leaving `records` empty, if the header does
+// not match or any record holds an op other than ENQUEUE, DEQUEUE or
+// PRIORITIZE.
+inline bool readTrace(const std::string& path, std::vector<TraceRecord>& records) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    TraceFileHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+        && std::memcmp(header.magic, kTraceMagic, sizeof(kTraceMagic)) == 0
+        && header.version == kTraceVersion && header.recordSize == sizeof(TraceRecord);
+    if (ok) {
+        records.clear();
+        TraceRecord chunk[4096];
+        for (std::size_t n; (n = std::fread(chunk, sizeof(TraceRecord), 4096, file)) > 0;) {
+            records.insert(records.end(), chunk, chunk + n);
+        }
+        ok = std::ranges::all_of(records, [](const TraceRecord& record) {
+            return record.op == QueueOp::ENQUEUE || record.op == QueueOp::DEQUEUE || record.op == QueueOp::PRIORITIZE;
+        });
+        if (!ok) records.clear();
+    }
+    std::fclose(file);
+    return ok;
+}
+
+// Latency percentiles, in nanoseconds, of one kind of operation in a replay.
+struct OperationLatency {
+    long long count = 0;
+    long long failed = 0; // enqueue on a full queue or dequeue on an empty one
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+};
+
+struct ReplayReport {
+    long long operations = 0;
+    double seconds = 0;
+    double opsPerSecond = 0;
+    double maxScheduleLagUs = 0; // recorded pace only: how late the worst op was issued
+    long long skipped = 0;       // records whose op replay does not know, not issued
+    OperationLatency enqueue, dequeue, prioritize;
+};
+
+enum class ReplayPace { FULL_SPEED, RECORDED };
+
+// Replays `trace` against any queue offering enqueue(const Call&) -> bool,
+// dequeue(Call&) -> bool and prioritizeEmergencyCalls(). FULL_SPEED issues
+// operations back to back; RECORDED issues each one at its recorded offset
+// from the start of the replay. Every operation is timed individually and
+// the cost of reading the clock is subtracted. Records with any other op are
+// not issued and are counted in ReplayReport::skipped.
+template <typename Queue>
+ReplayReport replayTrace(const std::vector<TraceRecord>& trace, Queue& queue, ReplayPace pace = ReplayPace::FULL_SPEED) {
+    std::int64_t clockCost = nowNanos();
+    for (int i = 0; i < 999; ++i) nowNanos();
+    clockCost = (nowNanos() - clockCost) / 1000;
+
+    std::vector<std::uint32_t> latencies[3];
+    long long failures[3] = {};
+    for (auto& samples : latencies) samples.reserve(trace.size());
+
+    ReplayReport report;
+    std::int64_t worstLag = 0;
+    std::int64_t start = nowNanos();
+    for (const TraceRecord& record : trace) {
+        if (pace == ReplayPace::RECORDED) {
+            std::int64_t due = start + record.timestampNs;
+            std::int64_t now = nowNanos();
+            while (now < due) {
+                if (due - now > 200000) ::usleep(static_cast<useconds_t>((due - now - 100000) / 1000));
+                now = nowNanos();
+            }
+            worstLag = std::max(worstLag, now - due);
+        }
+        int kind;
+        bool ok = true;
+        std::int64_t opStart = nowNanos();
+        if (record.op == QueueOp::ENQUEUE) {
+            kind = 0;
+            ok = queue.enqueue(Call{ record.callId, record.type, record.duration, record.callbackRequested });
+        }
+        else if (record.op == QueueOp::DEQUEUE) {
+            kind = 1;
+            Call call;
+            ok = queue.dequeue(call);
+        }
+        else if (record.op == QueueOp::PRIORITIZE) {
+            kind = 2;
+            queue.prioritizeEmergencyCalls();
+        }
+        else {
+            ++report.skipped;
+            continue;
+        }
+        std::int64_t elapsed = nowNanos() - opStart - clockCost;
+        latencies[kind].push_back(static_cast<std::uint32_t>(std::max<std::int64_t>(elapsed, 0)));
+        if (!ok) ++failures[kind];
+    }
+    report.seconds = (nowNanos() - start) / 1e9;
+    report.operations = static_cast<long long>(trace.size()) - report.skipped;
+    report.opsPerSecond = report.seconds > 0 ? report.operations / report.seconds : 0;
+    report.maxScheduleLagUs = worstLag / 1000.0;
+
+    OperationLatency* summaries[3] = { &report.enqueue, &report.dequeue, &report.prioritize };
+    for (int kind = 0; kind < 3; ++kind) {
+        std::vector<std::uint32_t>& samples = latencies[kind];
+        OperationLatency& summary = *summaries[kind];
+        summary.count = static_cast<long long>(samples.size());
+        summary.failed = failures[kind];
+        if (samples.empty()) continue;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) { return static_cast<double>(samples[static_cast<std::size_t>(q * (samples.size() - 1))]); };
+        summary.p50 = at(0.5);
+        summary.p90 = at(0.9);
+        summary.p99 = at(0.99);
+        summary.p999 = at(0.999);
+        summary.max = samples.back();
+    }
+    return report;
+}
+
+// xoshiro256** pseudo-random generator: a few cycles per draw and the same
+// sequence on every platform for a given seed.
+class FastRandom {
+private:
+    std::uint64_t s[4];
+
+    static std::uint64_t rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit FastRandom(std::uint64_t seed = 1) {
+        for (auto& word : s) { // splitmix64 expansion of the seed
+            seed += 0x9E3779B97F4A7C15ull;
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    std::uint64_t next() {
+        std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1).
+    double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+    double exponential(double mean) { return -mean * std::log1p(-uniform()); }
+};
+
+enum class ArrivalModel { POISSON, MMPP, DIURNAL };
+enum class DurationModel { FIXED, UNIFORM, EXPONENTIAL };
+
+// Shape of a synthetic call load. Rates are calls per second of simulated time.
+struct LoadProfile {
+    ArrivalModel arrivals = ArrivalModel::POISSON;
+    double callsPerSecond = 1000;
+    // MMPP: a two-state Markov-modulated Poisson process that alternates
+    // between calm and burst periods of exponentially distributed length.
+    double burstMultiplier = 8;
+    double meanCalmSeconds = 60;
+    double meanBurstSeconds = 10;
+    // DIURNAL: rate(t) = callsPerSecond * (1 + amplitude * sin(2*pi*t / period)).
+    double diurnalAmplitude = 0.8;
+    double diurnalPeriodSeconds = 86400;
+    double emergencyRatio = 0.1;
+    double callbackRatio = 0.2;
+    DurationModel durations = DurationModel::EXPONENTIAL;
+    double meanDuration = 5; // minutes; calls last at least 1, so means below 1 act as 1
+
+    // Rates and periods positive, ratios within [0, 1], and a trough rate
+    // that does not go negative.
+    bool isValid() const {
+        return callsPerSecond > 0 && burstMultiplier > 0 && meanCalmSeconds > 0 && meanBurstSeconds > 0
+            && diurnalAmplitude >= 0 && diurnalAmplitude <= 1 && diurnalPeriodSeconds > 0
+            && emergencyRatio >= 0 && emergencyRatio <= 1 && callbackRatio >= 0 && callbackRatio <= 1
+            && meanDuration > 0;
+    }
+};
+
+// Produces an endless stream of calls and their arrival times for a
+// LoadProfile. Generators meant to run side by side (one per thread) are
+// given the same profile and seed but different `streamIndex` values out of
+// `streamCount`: each then produces 1/streamCount of the rate with disjoint
+// callIds, and all of them follow the same MMPP burst schedule, so their
+// merged output follows the profile.
+class CallLoadGenerator {
+private:
+    LoadProfile profile;
+    FastRandom random;
+    FastRandom phaseRandom; // drives MMPP bursts, identical in every stream
+    double rate;
+    double clock = 0;       // seconds
+    bool bursting = false;
+    double phaseEnd;
+    int nextCallId;
+    int callIdStride;
+
+    double nextArrival() {
+        switch (profile.arrivals) {
+        case ArrivalModel::POISSON:
+            clock += random.exponential(1.0 / rate);
+            break;
+        case ArrivalModel::MMPP:
+            while (true) {
+                double gap = random.exponential(1.0 / (bursting ? rate * profile.burstMultiplier : rate));
+                if (clock + gap < phaseEnd) {
+                    clock += gap;
+                    break;
+                }
+                // Exponential gaps are memoryless, so restarting at the phase change is exact.
+                clock = phaseEnd;
+                bursting = !bursting;
+                phaseEnd += phaseRandom.exponential(bursting ? profile.meanBurstSeconds : profile.meanCalmSeconds);
+            }
+            break;
+        case ArrivalModel::DIURNAL: {
+            // Thinning: draw at the peak rate and keep each arrival with
+            // probability rate(t) / peak rate.
+            double peak = rate * (1 + profile.diurnalAmplitude);
+            double omega = 2 * M_PI / profile.diurnalPeriodSeconds;
+            do {
+                clock += random.exponential(1.0 / peak);
+            } while (random.uniform() * peak > rate * (1 + profile.diurnalAmplitude * std::sin(omega * clock)));
+            break;
+        }
+        }
+        return clock;
+    }
+
+    int nextDuration() {
+        double mean = profile.meanDuration;
+        switch (profile.durations) {
+        case DurationModel::FIXED:
+            return static_cast<int>(mean);
+        case DurationModel::UNIFORM:
+            return 1 + static_cast<int>(random.uniform() * (2 * mean - 1));
+        case DurationModel::EXPONENTIAL:
+            return 1 + static_cast<int>(random.exponential(mean - 0.5));
+        }
+        return static_cast<int>(mean);
+    }
+
+public:
+    CallLoadGenerator(const LoadProfile& loadProfile, std::uint64_t seed, int streamIndex = 0, int streamCount = 1,
+                      int firstCallId = 1)
+        : profile(loadProfile), random(seed * 0x100000001B3ull + streamIndex), phaseRandom(seed),
+          rate(loadProfile.callsPerSecond / streamCount), nextCallId(firstCallId + streamIndex),
+          callIdStride(streamCount) {
+        profile.meanDuration = std::max(1.0, profile.meanDuration);
+        phaseEnd = phaseRandom.exponential(profile.meanCalmSeconds);
+    }
+
+    // Next call; `arrivalNs` is its arrival time since the start of the load.
+    Call next(std::int64_t& arrivalNs) {
+        arrivalNs = static_cast<std::int64_t>(nextArrival() * 1e9);
+        Call call{};
+        call.callId = nextCallId;
+        nextCallId += callIdStride;
+        call.type = random.uniform() < profile.emergencyRatio ? CallType::EMERGENCY : CallType::NORMAL;
+        call.duration = nextDuration();
+        call.callbackRequested = random.uniform() < profile.callbackRatio;
+        return call;
+    }
+
+    // Fills `count` calls and arrival times; the batch form used on hot paths.
+    void generate(Call* calls, std::int64_t* arrivalNs, int count) {
+        for (int i = 0; i < count; ++i) calls[i] = next(arrivalNs[i]);
+    }
+
+    // Enqueues the next `count` calls into `queue`, returning how many fit.
+    template <typename Queue>
+    long long feed(Queue& queue, long long count) {
+        long long accepted = 0;
+        std::int64_t arrivalNs;
+        for (long long i = 0; i < count; ++i) accepted += queue.enqueue(next(arrivalNs)) ? 1 : 0;
+        return accepted;
+    }
+
+    // Writes `count` arrivals to a trace file for replay, interleaved with
+    // DEQUEUE records at a steady `dequeuesPerSecond` (0 for none).
+    bool writeTrace(const std::string& path, long long count, double dequeuesPerSecond = 0) {
+        TraceWriter writer(path);
+        if (!writer.isOpen()) return false;
+        double dequeueGapNs = dequeuesPerSecond > 0 ? 1e9 / dequeuesPerSecond : 0;
+        double nextDequeueNs = dequeueGapNs;
+        for (long long i = 0; i < count; ++i) {
+            std::int64_t arrivalNs;
+            Call call = next(arrivalNs);
+            while (dequeueGapNs > 0 && nextDequeueNs <= arrivalNs) {
+                TraceRecord dequeue{};
+                dequeue.timestampNs = static_cast<std::int64_t>(nextDequeueNs);
+                dequeue.op = QueueOp::DEQUEUE;
+                if (!writer.write(dequeue)) return false;
+                nextDequeueNs += dequeueGapNs;
+            }
+            TraceRecord record{};
+            record.timestampNs = arrivalNs;
+            record.op = QueueOp::ENQUEUE;
+            record.type = call.type;
+            record.callbackRequested = call.callbackRequested;
+            record.callId = call.callId;
+            record.duration = call.duration;
+            if (!writer.write(record)) return false;
+        }
+        return true;
+    }
+};
+
+enum class DispatchMode { FIFO, EMERGENCY_FIRST, AGING, WEIGHTED_FAIR };
+
+struct SchedulerPolicy {
+    DispatchMode mode = DispatchMode::AGING;
+    // AGING: a waiting call's priority is basePriority + agingPerSecond * its
+    // wait in seconds, and the higher priority head is served. With the
+    // defaults a NORMAL call overtakes an EMERGENCY call that has waited
+    // 600s less than it.
+    double basePriority[2] = { 0, 600 };
+    double agingPerSecond[2] = { 1, 1 };
+    // WEIGHTED_FAIR: each type receives service time (Call::duration) in
+    // proportion to its weight while both have calls waiting.
+    double weight[2] = { 1, 4 };
+};
+
+// Dispatches calls from one FIFO CircularQueue per CallType, choosing which
+// type to serve next by the policy. Both policies only compare the two queue
+// heads, so dequeue stays O(1).
+//
+// FIFO serves calls in arrival order regardless of type. EMERGENCY_FIRST
+// serves EMERGENCY calls whenever there are any, like
+// prioritizeEmergencyCalls. A sustained emergency surge then starves NORMAL
+// calls. AGING bounds a NORMAL call's wait to roughly the EMERGENCY head start
+// plus the current emergency wait. WEIGHTED_FAIR guarantees NORMAL calls a
+// fixed share of agent time.
+//
+// Times are passed in so the scheduler can be driven by simulated clocks;
+// enqueue stamps Call::enqueuedAtNs with `nowNs`.
+class CallScheduler {
+private:
+    CircularQueue byType[2];
+    SchedulerPolicy policy;
+    double virtualFinish[2] = { 0, 0 }; // WEIGHTED_FAIR virtual time of each type
+    double virtualTime = 0;
+
+    int pick(std::int64_t nowNs) const {
+        const Call* normal = byType[0].peek();
+        const Call* emergency = byType[1].peek();
+        if (!normal || !emergency) return normal ? 0 : 1;
+        switch (policy.mode) {
+        case DispatchMode::FIFO:
+            return normal->enqueuedAtNs <= emergency->enqueuedAtNs ? 0 : 1;
+        case DispatchMode::EMERGENCY_FIRST:
+            return 1;
+        case DispatchMode::AGING: {
+            double normalPriority = policy.basePriority[0] + policy.agingPerSecond[0] * (nowNs - normal->enqueuedAtNs) / 1e9;
+            double emergencyPriority = policy.basePriority[1] + policy.agingPerSecond[1] * (nowNs - emergency->enqueuedAtNs) / 1e9;
+            return normalPriority > emergencyPriority ? 0 : 1;
+        }
+        case DispatchMode::WEIGHTED_FAIR:
+            return virtualFinish[0] < virtualFinish[1] ? 0 : 1;
+        }
+        return 1;
+    }
+
+public:
+    CallScheduler(int capacityPerType, const SchedulerPolicy& schedulerPolicy = SchedulerPolicy())
+        : byType{ CircularQueue(capacityPerType), CircularQueue(capacityPerType) }, policy(schedulerPolicy) {
+        for (CircularQueue& queue : byType) queue.setVerbose(false);
+    }
+
+    int size() const { return byType[0].size() + byType[1].size(); }
+    bool isEmpty() const { return byType[0].isEmpty() && byType[1].isEmpty(); }
+    const CircularQueue& queueFor(CallType type) const { return byType[static_cast<int>(type)]; }
+
+    bool enqueue(const Call& call, std::int64_t nowNs = nowNanos()) {
+        int type = static_cast<int>(call.type);
+        // A type that had nothing waiting rejoins at the current virtual time
+        // instead of claiming the service it did not use while idle.
+        if (byType[type].isEmpty()) virtualFinish[type] = std::max(virtualFinish[type], virtualTime);
+        Call stamped = call;
+        stamped.enqueuedAtNs = nowNs;
+        return byType[type].enqueue(stamped);
+    }
+
+    bool dequeue(Call& out, std::int64_t nowNs = nowNanos()) {
+        if (isEmpty()) return false;
+        int type = pick(nowNs);
+        byType[type].dequeue(out);
+        virtualTime = virtualFinish[type];
+        virtualFinish[type] += std::max(out.duration, 1) / policy.weight[type];
+        return true;
+    }
+};
+
+// Outcome of a dispatch simulation, with wait times in nanoseconds.
+struct DispatchSimulation {
+    LatencyHistogram waits[2]; // per CallType
+    double meanWaitNs[2] = { 0, 0 };
+    long long missedDeadlines[2] = { 0, 0 }; // answered after Call::deadlineNs
+    long long served = 0;
+    long long dropped = 0;     // arrivals that found the queue full
+};
+
+// Simulates `agents` agents taking calls from `scheduler`. `arrivals` holds
+// (arrival time in ns, call) in time order. Each call keeps its agent busy for
+// Call::duration minutes. The scheduler only needs enqueue(call, nowNs) and
+// dequeue(call&, nowNs), so any dispatch policy can be compared on the same
+// arrivals.
+template <typename Scheduler>
+DispatchSimulation simulateDispatch(Scheduler& scheduler, const std::vector<std::pair<std::int64_t, Call>>& arrivals, int agents) {
+    DispatchSimulation result;
+    double waitSum[2] = { 0, 0 };
+    std::priority_queue<std::int64_t, std::vector<std::int64_t>, std::greater<std::int64_t>> agentFreeAt;
+    for (int i = 0; i < agents; ++i) agentFreeAt.push(0);
+
+    std::size_t next = 0;
+    std::int64_t now = 0;
+    while (next < arrivals.size() || !scheduler.isEmpty()) {
+        std::int64_t freeAt = agentFreeAt.top();
+        if (next < arrivals.size() && (arrivals[next].first <= freeAt || scheduler.isEmpty())) {
+            now = arrivals[next].first;
+            if (!scheduler.enqueue(arrivals[next].second, now)) ++result.dropped;
+            ++next;
+            continue;
+        }
+        // An agent that went idle before the latest arrival answers it on arrival.
+        std::int64_t answeredAt = std::max(freeAt, now);
+        agentFreeAt.pop();
+        Call call{};
+        scheduler.dequeue(call, answeredAt);
+        std::int64_t wait = answeredAt - call.enqueuedAtNs;
+        int type = static_cast<int>(call.type);
+        result.waits[type].counts[LatencyHistogram::bucketIndex(wait)]++;
+        waitSum[type] += wait;
+        if (call.deadlineNs && answeredAt > call.deadlineNs) ++result.missedDeadlines[type];
+        ++result.served;
+        agentFreeAt.push(answeredAt + static_cast<std::int64_t>(call.duration) * 60 * 1000000000LL);
+    }
+    for (int type = 0; type < 2; ++type) {
+        std::uint64_t count = result.waits[type].count();
+        result.meanWaitNs[type] = count ? waitSum[type] / count : 0;
+    }
+    return result;
+}
+
+// Arrivals for dispatch simulations: steady Poisson NORMAL traffic plus
+// EMERGENCY traffic that surges (MMPP) past what the agents can answer.
+inline std::vector<std::pair<std::int64_t, Call>> surgeArrivals(double hours, double normalPerHour, double emergencyPerHour,
+                                                                double surgeMultiplier, std::uint64_t seed) {
+    LoadProfile normal;
+    normal.callsPerSecond = normalPerHour / 3600;
+    normal.emergencyRatio = 0;
+    LoadProfile emergency;
+    emergency.arrivals = ArrivalModel::MMPP;
+    emergency.callsPerSecond = emergencyPerHour / 3600;
+    emergency.burstMultiplier = surgeMultiplier;
+    emergency.meanCalmSeconds = 4 * 3600;
+    emergency.meanBurstSeconds = 3600;
+    emergency.emergencyRatio = 1;
+
+    std::vector<std::pair<std::int64_t, Call>> arrivals;
+    std::int64_t end = static_cast<std::int64_t>(hours * 3600 * 1e9);
+    CallLoadGenerator normalCalls(normal, seed, 0, 2);
+    CallLoadGenerator emergencyCalls(emergency, seed + 1, 1, 2);
+    for (CallLoadGenerator* generator : { &normalCalls, &emergencyCalls }) {
+        std::int64_t at;
+        for (Call call = generator->next(at); at < end; call = generator->next(at)) arrivals.emplace_back(at, call);
+    }
+    std::sort(arrivals.begin(), arrivals.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+    return arrivals;
+}
+
+// Answer-time SLA per CallType: how long a call may wait before it is late.
+struct SlaPolicy {
+    std::int64_t answerWithinNs[2] = { 300 * 1000000000LL, 30 * 1000000000LL };
+
+    std::int64_t deadlineFor(CallType type, std::int64_t enqueuedAtNs) const {
+        return enqueuedAtNs + answerWithinNs[static_cast<int>(type)];
+    }
+};
+
+// Gives each call in `arrivals` the SLA deadline of its arrival time.
+inline void applySlaDeadlines(std::vector<std::pair<std::int64_t, Call>>& arrivals, const SlaPolicy& sla) {
+    for (auto& [arrivalNs, call] : arrivals) call.deadlineNs = sla.deadlineFor(call.type, arrivalNs);
+}
+
+// Earliest-deadline-first dispatch: dequeue always returns the waiting call
+// whose Call::deadlineNs is soonest, with ties served in arrival order. Calls
+// enqueued without a deadline get one from the SlaPolicy. Calls are kept in a
+// binary heap, so enqueue and dequeue are O(log n); at 1M queued calls that is
+// about 20 levels.
+//
+// A call dequeued after its deadline is counted as a missed deadline.
+// Drop-in for CallScheduler in simulateDispatch.
+class DeadlineScheduler {
+private:
+    struct Entry {
+        std::int64_t deadlineNs;
+        std::uint64_t sequence;
+        Call call;
+    };
+    struct Later {
+        bool operator()(const Entry& a, const Entry& b) const {
+            return a.deadlineNs != b.deadlineNs ? a.deadlineNs > b.deadlineNs : a.sequence > b.sequence;
+        }
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, Later> heap;
+    SlaPolicy sla;
+    int capacity;
+    std::uint64_t nextSequence = 0;
+    long long missed[2] = { 0, 0 };
+
+    static std::vector<Entry> reservedStorage(int capacity) {
+        std::vector<Entry> storage;
+        storage.reserve(capacity);
+        return storage;
+    }
+
+public:
+    DeadlineScheduler(int size, const SlaPolicy& slaPolicy = SlaPolicy())
+        : heap(Later(), reservedStorage(size)), sla(slaPolicy), capacity(size) {}
+
+    int size() const { return static_cast<int>(heap.size()); }
+    bool isEmpty() const { return heap.empty(); }
+    const Call* peek() const { return heap.empty() ? nullptr : &heap.top().call; }
+    long long missedDeadlines(CallType type) const { return missed[static_cast<int>(type)]; }
+    long long missedDeadlines() const { return missed[0] + missed[1]; }
+
+    bool enqueue(const Call& call, std::int64_t nowNs = nowNanos()) {
+        if (size() >= capacity) return false;
+        Call stamped = call;
+        stamped.enqueuedAtNs = nowNs;
+        if (!stamped.deadlineNs) stamped.deadlineNs = sla.deadlineFor(call.type, nowNs);
+        heap.push(Entry{ stamped.deadlineNs, nextSequence++, stamped });
+        return true;
+    }
+
+    bool dequeue(Call& out, std::int64_t nowNs = nowNanos()) {
+        if (heap.empty()) return false;
+        out = heap.top().call;
+        heap.pop();
+        if (nowNs > out.deadlineNs) ++missed[static_cast<int>(out.type)];
+        return true;
+    }
+};
+
+// Serves EMERGENCY calls before NORMAL calls and, within each CallType, the
+// call with the shortest expected duration first, which minimizes mean wait.
+// Calls of equal duration are served in arrival order.
+//
+// Pure shortest-first can make a long call wait forever while shorter calls
+// keep arriving. With a starvation bound, a call that has waited longer than
+// the bound is served ahead of shorter calls, oldest first.
+//
+// Each type keeps one FIFO bucket per duration in minutes. Durations of
+// kBuckets - 1 minutes or more share the last bucket in arrival order. A
+// bitmask of non-empty buckets finds the shortest call with one
+// count-trailing-zeros. The oldest call is at the head of one of the buckets,
+// so the starvation check looks at no more than kBuckets heads.
+class ShortestFirstScheduler {
+public:
+    static constexpr int kBuckets = 64;
+    static constexpr std::int64_t kNoStarvationBound = std::numeric_limits<std::int64_t>::max();
+
+private:
+    struct Lane {
+        std::deque<Call> buckets[kBuckets];
+        std::uint64_t nonEmpty = 0;
+    };
+
+    Lane lanes[2];
+    std::int64_t starvationBoundNs;
+    int capacity;
+    int count = 0;
+    long long starvationPromotions = 0;
+
+    static int bucketFor(int duration) {
+        return std::clamp(duration, 0, kBuckets - 1);
+    }
+
+public:
+    ShortestFirstScheduler(int size, std::int64_t boundNs = kNoStarvationBound)
+        : starvationBoundNs(boundNs), capacity(size) {}
+
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    // Calls served ahead of shorter ones because they hit the starvation bound.
+    long long promotions() const { return starvationPromotions; }
+
+    bool enqueue(const Call& call, std::int64_t nowNs = nowNanos()) {
+        if (count >= capacity) return false;
+        Lane& lane = lanes[static_cast<int>(call.type)];
+        int bucket = bucketFor(call.duration);
+        lane.buckets[bucket].push_back(call);
+        lane.buckets[bucket].back().enqueuedAtNs = nowNs;
+        lane.nonEmpty |= std::uint64_t{ 1 } << bucket;
+        ++count;
+        return true;
+    }
+
+    bool dequeue(Call& out, std::int64_t nowNs = nowNanos()) {
+        if (count == 0) return false;
+        Lane& lane = lanes[1].nonEmpty ? lanes[1] : lanes[0];
+        int bucket = std::countr_zero(lane.nonEmpty);
+        if (starvationBoundNs != kNoStarvationBound) {
+            int oldest = bucket;
+            for (std::uint64_t rest = lane.nonEmpty & (lane.nonEmpty - 1); rest; rest &= rest - 1) {
+                int candidate = std::countr_zero(rest);
+                if (lane.buckets[candidate].front().enqueuedAtNs < lane.buckets[oldest].front().enqueuedAtNs) oldest = candidate;
+            }
+            if (oldest != bucket && nowNs - lane.buckets[oldest].front().enqueuedAtNs > starvationBoundNs) {
+                bucket = oldest;
+                ++starvationPromotions;
+            }
+        }
+        out = lane.buckets[bucket].front();
+        lane.buckets[bucket].pop_front();
+        if (lane.buckets[bucket].empty()) lane.nonEmpty &= ~(std::uint64_t{ 1 } << bucket);
+        --count;
+        return true;
+    }
+};
+
+// Fire-and-forget coroutine run by an EventLoop. It starts suspended until
+// EventLoop::spawn schedules it, and its frame is freed when it returns.
+struct CallTask {
+    struct promise_type {
+        CallTask get_return_object() { return CallTask{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Single-threaded executor: resumes scheduled coroutines in order until none
+// are ready. The two handle buffers are swapped and reused between passes, so
+// once they have grown to the peak number of ready coroutines, scheduling
+// never allocates.
+class EventLoop {
+private:
+    std::vector<std::coroutine_handle<>> ready;
+    std::vector<std::coroutine_handle<>> running;
+
+public:
+    void schedule(std::coroutine_handle<> handle) { ready.push_back(handle); }
+
+    void spawn(CallTask task) { schedule(task.handle); }
+
+    // Runs until no coroutine is ready; returns how many resumptions it made.
+    long long run() {
+        long long resumed = 0;
+        while (!ready.empty()) {
+            running.swap(ready);
+            for (std::coroutine_handle<> handle : running) {
+                handle.resume();
+                ++resumed;
+            }
+            running.clear();
+        }
+        return resumed;
+    }
+};
+
+// Coroutine interface to a CircularQueue:
+//
+//     Call call = co_await calls.asyncDequeue();
+//     co_await calls.asyncEnqueue(call);
+//
+// asyncDequeue suspends while the queue is empty. asyncEnqueue suspends
+// while it is full, instead of overflowing. Waiting coroutines are served
+// first come, first served. They are resumed on the EventLoop, not inside the
+// operation that unblocked them.
+//
+// Each awaiter lives in its coroutine's frame and doubles as the node of an
+// intrusive waiter list. Suspending and resuming therefore never allocate.
+// Single-threaded: use the queue and the loop from one thread.
+class AsyncCallQueue {
+private:
+    struct Waiter {
+        AsyncCallQueue* owner = nullptr;
+        Call call{};
+        std::coroutine_handle<> handle{};
+        Waiter* next = nullptr;
+    };
+
+    struct WaiterList {
+        Waiter* head = nullptr;
+        Waiter* tail = nullptr;
+
+        bool empty() const { return head == nullptr; }
+
+        void push(Waiter* waiter) {
+            waiter->next = nullptr;
+            (tail ? tail->next : head) = waiter;
+            tail = waiter;
+        }
+
+        Waiter* pop() {
+            Waiter* waiter = head;
+            head = waiter->next;
+            if (!head) tail = nullptr;
+            return waiter;
+        }
+    };
+
+    CircularQueue& queue;
+    EventLoop& loop;
+    WaiterList consumers;
+    WaiterList producers;
+
+    // Hands queued calls to waiting consumers and free slots to waiting
+    // producers until neither can make progress.
+    void wakeWaiters() {
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            while (!consumers.empty() && !queue.isEmpty()) {
+                Waiter* consumer = consumers.pop();
+                queue.dequeue(consumer->call);
+                loop.schedule(consumer->handle);
+                progress = true;
+            }
+            while (!producers.empty() && !queue.isFull()) {
+                Waiter* producer = producers.pop();
+                queue.enqueue(producer->call);
+                loop.schedule(producer->handle);
+                progress = true;
+            }
+        }
+    }
+
+public:
+    AsyncCallQueue(CircularQueue& callQueue, EventLoop& eventLoop) : queue(callQueue), loop(eventLoop) {}
+
+    struct DequeueAwaiter : Waiter {
+        bool await_ready() {
+            if (this->owner->queue.isEmpty()) return false;
+            this->owner->queue.dequeue(this->call);
+            this->owner->wakeWaiters();
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> waiting) {
+            this->handle = waiting;
+            this->owner->consumers.push(this);
+        }
+        Call await_resume() { return this->call; }
+    };
+
+    struct EnqueueAwaiter : Waiter {
+        bool await_ready() {
+            if (this->owner->queue.isFull()) return false;
+            this->owner->queue.enqueue(this->call);
+            this->owner->wakeWaiters();
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> waiting) {
+            this->handle = waiting;
+            this->owner->producers.push(this);
+        }
+        void await_resume() {}
+    };
+
+    DequeueAwaiter asyncDequeue() { return DequeueAwaiter{ { this, Call{} } }; }
+    EnqueueAwaiter asyncEnqueue(const Call& call) { return EnqueueAwaiter{ { this, call } }; }
+};
+
+// Coroutine that enqueues `count` calls with consecutive ids from `firstCallId`.
+CallTask produceCalls(AsyncCallQueue& calls, int firstCallId, int count, bool verbose) {
+    for (int callId = firstCallId; callId < firstCallId + count; ++callId) {
+        co_await calls.asyncEnqueue(Call{ callId, (callId % 8) ? CallType::NORMAL : CallType::EMERGENCY, 5, false });
+        if (verbose) std::cout << "Producer enqueued Call ID: " << callId << "\n";
+    }
+}
+
+// Coroutine that answers `count` calls, adding their ids to `callIdSum`.
+CallTask answerCalls(AsyncCallQueue& calls, int count, bool verbose, long long& callIdSum) {
+    for (int i = 0; i < count; ++i) {
+        Call call = co_await calls.asyncDequeue();
+        callIdSum += call.callId;
+        if (verbose) std::cout << "Consumer answered Call ID: " << call.callId << "\n";
+    }
+}
+
+enum class ShedPolicy {
+    DROP_INCOMING,       // reject whatever arrives while the queue is full
+    REJECT_NORMAL,       // keep `emergencyReserve` slots that only EMERGENCY calls may use
+    EVICT_NEWEST_NORMAL, // when full, evict the most recent NORMAL call to admit an EMERGENCY call
+    EVICT_OLDEST_NORMAL, // when full, evict the longest-waiting NORMAL call to admit an EMERGENCY call
+    EARLY_DROP           // drop NORMAL calls with a probability that rises with depth
+};
+
+struct AdmissionPolicy {
+    ShedPolicy mode = ShedPolicy::EVICT_NEWEST_NORMAL;
+    int emergencyReserve = 0;      // REJECT_NORMAL
+    double earlyDropStart = 0.5;   // EARLY_DROP: depth fraction where dropping starts
+    double earlyDropFull = 0.9;    // EARLY_DROP: depth fraction where every NORMAL call is dropped
+};
+
+enum class AdmissionOutcome { ADMITTED, ADMITTED_AFTER_EVICTION, REJECTED_FULL, REJECTED_SHED, REJECTED_EARLY_DROP };
+
+inline const char* admissionOutcomeName(AdmissionOutcome outcome) {
+    switch (outcome) {
+    case AdmissionOutcome::ADMITTED: return "ADMITTED";
+    case AdmissionOutcome::ADMITTED_AFTER_EVICTION: return "ADMITTED_AFTER_EVICTION";
+    case AdmissionOutcome::REJECTED_FULL: return "REJECTED_FULL";
+    case AdmissionOutcome::REJECTED_SHED: return "REJECTED_SHED";
+    case AdmissionOutcome::REJECTED_EARLY_DROP: return "REJECTED_EARLY_DROP";
+    }
+    return "UNKNOWN";
+}
+
+// What happened to an offered call, for the caller to act on (e.g. offer a
+// callback to a rejected or evicted caller).
+struct AdmissionResult {
+    AdmissionOutcome outcome;
+    int depth;                  // calls waiting after the decision
+    double dropProbability = 0; // EARLY_DROP probability applied to this call
+    bool evicted = false;
+    Call evictedCall{};         // set when `evicted`
+
+    bool admitted() const {
+        return outcome == AdmissionOutcome::ADMITTED || outcome == AdmissionOutcome::ADMITTED_AFTER_EVICTION;
+    }
+};
+
+// Bounded call queue that decides, under overload, which calls to shed
+// instead of dropping whatever arrives. All policies protect EMERGENCY calls
+// at the expense of NORMAL ones except DROP_INCOMING, which is the plain
+// CircularQueue behaviour.
+//
+// Calls wait in one CircularQueue per CallType. Each decision reads the
+// depths and at most one end of the NORMAL ring, so every decision,
+// including evicting the oldest or newest NORMAL call, is O(1). dequeue
+// serves EMERGENCY calls first, the order prioritizeEmergencyCalls gives.
+class AdmissionController {
+private:
+    CircularQueue byType[2];
+    AdmissionPolicy policy;
+    int capacity;
+    FastRandom random;
+    long long outcomes[5][2] = {}; // [AdmissionOutcome][CallType]
+    long long evictions = 0;
+
+    AdmissionResult decide(const Call& call) {
+        int depth = size();
+        bool emergency = call.type == CallType::EMERGENCY;
+        switch (policy.mode) {
+        case ShedPolicy::DROP_INCOMING:
+            break;
+        case ShedPolicy::REJECT_NORMAL:
+            if (!emergency && depth >= capacity - policy.emergencyReserve) return { AdmissionOutcome::REJECTED_SHED, depth };
+            break;
+        case ShedPolicy::EVICT_NEWEST_NORMAL:
+        case ShedPolicy::EVICT_OLDEST_NORMAL:
+            if (emergency && depth >= capacity && !byType[0].isEmpty()) {
+                AdmissionResult result{ AdmissionOutcome::ADMITTED_AFTER_EVICTION, depth };
+                result.evicted = true;
+                if (policy.mode == ShedPolicy::EVICT_NEWEST_NORMAL) {
+                    byType[0].removeNewest(result.evictedCall);
+                }
+                else {
+                    result.evictedCall = *byType[0].peek();
+                    byType[0].cancel(result.evictedCall.callId); // at the front, so O(1)
+                }
+                return result;
+            }
+            break;
+        case ShedPolicy::EARLY_DROP:
+            if (!emergency) {
+                double fill = static_cast<double>(depth) / capacity;
+                double probability = std::clamp((fill - policy.earlyDropStart) / (policy.earlyDropFull - policy.earlyDropStart), 0.0, 1.0);
+                if (probability > 0 && random.uniform() < probability) {
+                    AdmissionResult result{ AdmissionOutcome::REJECTED_EARLY_DROP, depth };
+                    result.dropProbability = probability;
+                    return result;
+                }
+            }
+            break;
+        }
+        if (depth >= capacity) return { AdmissionOutcome::REJECTED_FULL, depth };
+        return { AdmissionOutcome::ADMITTED, depth };
+    }
+
+public:
+    AdmissionController(int size, const AdmissionPolicy& admissionPolicy = AdmissionPolicy(), std::uint64_t seed = 1)
+        : byType{ CircularQueue(size), CircularQueue(size) }, policy(admissionPolicy), capacity(size), random(seed) {
+        for (CircularQueue& queue : byType) queue.setVerbose(false);
+    }
+
+    int size() const { return byType[0].size() + byType[1].size(); }
+    bool isEmpty() const { return byType[0].isEmpty() && byType[1].isEmpty(); }
+    int countOf(CallType type) const { return byType[static_cast<int>(type)].size(); }
+    long long outcomeCount(AdmissionOutcome outcome, CallType type) const {
+        return outcomes[static_cast<int>(outcome)][static_cast<int>(type)];
+    }
+    long long evictedCount() const { return evictions; }
+
+    AdmissionResult offer(const Call& call) {
+        AdmissionResult result = decide(call);
+        if (result.admitted()) {
+            byType[static_cast<int>(call.type)].enqueue(call);
+            result.depth = size();
+        }
+        if (result.evicted) ++evictions;
+        ++outcomes[static_cast<int>(result.outcome)][static_cast<int>(call.type)];
+        return result;
+    }
+
+    bool dequeue(Call& out) {
+        if (!byType[1].isEmpty()) return byType[1].dequeue(out);
+        return byType[0].dequeue(out);
+    }
+};
+
+// splitmix64 finalizer: spreads any 64-bit key over all 64 bits.
+inline std::uint64_t mixKey(std::uint64_t key) {
+    key += 0x9E3779B97F4A7C15ull;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+    return key ^ (key >> 31);
+}
+
+// Counting Bloom filter with 4-bit counters, blocked so all of a key's
+// counters share one 64-byte cache line. The high bits of the key's hash pick
+// the block, and six 7-bit fields of the low bits pick counters within it.
+// Counters saturate at 15 and are then never decremented, so remove can never
+// cause a false negative.
+//
+// The filter holds `layers` independent filters with their blocks for the
+// same hash side by side, so checking every layer touches adjacent cache
+// lines of one page: one TLB miss and one memory round trip, even when the
+// filter is far larger than the caches.
+class CountingBloomFilter {
+private:
+    static constexpr int kHashes = 6;
+    struct alignas(64) Block {
+        std::uint64_t words[8]; // 16 counters each
+    };
+
+    std::size_t blocksPerLayer;
+    int layers;
+    std::vector<Block> blocks;
+
+    std::size_t blockIndex(std::uint64_t hash, int layer) const {
+        return static_cast<std::size_t>((static_cast<unsigned __int128>(hash) * blocksPerLayer) >> 64) * layers + layer;
+    }
+
+    static unsigned counterIndex(std::uint64_t hash, int i) { return (hash >> (7 * i)) & 127; }
+
+    static unsigned counterAt(const Block& block, unsigned index) {
+        return (block.words[index >> 4] >> ((index & 15) * 4)) & 15;
+    }
+
+public:
+    explicit CountingBloomFilter(std::size_t expectedKeys = 1, int layerCount = 1, int countersPerKey = 16)
+        : blocksPerLayer(std::max<std::size_t>(1, (expectedKeys * countersPerKey + 127) / 128)), layers(layerCount),
+          blocks(blocksPerLayer * layers, Block{}) {}
+
+    std::size_t bytes() const { return blocks.size() * sizeof(Block); }
+
+    bool mayContain(std::uint64_t hash, int layer = 0) const {
+        const Block& block = blocks[blockIndex(hash, layer)];
+        for (int i = 0; i < kHashes; ++i) {
+            if (counterAt(block, counterIndex(hash, i)) == 0) return false;
+        }
+        return true;
+    }
+
+    // Starts loading the blocks for `hash` ahead of a lookup.
+    void prefetch(std::uint64_t hash) const {
+        __builtin_prefetch(&blocks[blockIndex(hash, 0)]);
+        if (layers > 1) __builtin_prefetch(&blocks[blockIndex(hash, layers - 1)]);
+    }
+
+    bool mayContainInAnyLayer(std::uint64_t hash) const {
+        for (int layer = 0; layer < layers; ++layer) {
+            if (mayContain(hash, layer)) return true;
+        }
+        return false;
+    }
+
+    void insert(std::uint64_t hash, int layer = 0) {
+        Block& block = blocks[blockIndex(hash, layer)];
+        for (int i = 0; i < kHashes; ++i) {
+            unsigned index = counterIndex(hash, i);
+            if (counterAt(block, index) < 15) block.words[index >> 4] += std::uint64_t{ 1 } << ((index & 15) * 4);
+        }
+    }
+
+    void remove(std::uint64_t hash, int layer = 0) {
+        Block& block = blocks[blockIndex(hash, layer)];
+        for (int i = 0; i < kHashes; ++i) {
+            unsigned index = counterIndex(hash, i);
+            unsigned count = counterAt(block, index);
+            if (count > 0 && count < 15) block.words[index >> 4] -= std::uint64_t{ 1 } << ((index & 15) * 4);
+        }
+    }
+
+    void clear(int layer = 0) {
+        for (std::size_t index = layer; index < blocks.size(); index += layers) blocks[index] = Block{};
+    }
+};
+
+// Dedup stage for callers who redial while their earlier call is still
+// waiting. Callers are identified by a 64-bit key, such as their hashed phone
+// number. admit() says whether a call from that caller is new. Once the call
+// is answered or abandoned, forget() lets the caller in again.
+//
+// Most callers are not repeats. For them, the answer comes from a two-layer
+// counting Bloom filter, one layer per generation, without touching the
+// exact table. Only
+// filter positives are checked against the exact open-addressing table, so
+// false positives never reject a caller.
+//
+// Time decay: entries live in the current generation of `windowNs`. Each
+// rotation clears the older filter and drops the exact entries recorded in
+// it. A caller who is never forgotten (e.g. the hang-up was missed) is
+// therefore let in again after one to two windows. A repeat dial moves the
+// caller into the current generation.
+class RepeatCallerFilter {
+private:
+    struct Slot {
+        std::uint64_t key;
+        std::uint32_t epoch; // generation recorded in; 0 marks an empty slot
+    };
+
+    CountingBloomFilter generations; // layer g holds generation epochs with (epoch & 1) == g
+    std::vector<std::uint64_t> keysOf[2]; // keys recorded per generation, to expire them
+    std::uint32_t epoch = 1;              // current generation is generations[epoch & 1]
+    std::int64_t windowNs;
+    std::int64_t generationStartNs = -1;
+    std::vector<Slot> slots;              // power-of-two size, linear probing, at most 3/4 full
+    std::size_t used = 0;
+    long long queries = 0;
+    long long filterPositives = 0;
+    long long falsePositives = 0;
+
+    std::size_t findSlot(std::uint64_t key, std::uint64_t hash) const {
+        std::size_t mask = slots.size() - 1;
+        std::size_t index = hash & mask;
+        while (slots[index].epoch && slots[index].key != key) index = (index + 1) & mask;
+        return index;
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones.
+    void eraseSlot(std::size_t hole) {
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t index = (hole + 1) & mask; slots[index].epoch; index = (index + 1) & mask) {
+            std::size_t home = mixKey(slots[index].key) & mask;
+            if (((index - home) & mask) >= ((index - hole) & mask)) {
+                slots[hole] = slots[index];
+                hole = index;
+            }
+        }
+        slots[hole].epoch = 0;
+        --used;
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2, Slot{ 0, 0 });
+        old.swap(slots);
+        for (const Slot& slot : old) {
+            if (slot.epoch) slots[findSlot(slot.key, mixKey(slot.key))] = slot;
+        }
+    }
+
+    void expireGeneration(std::uint32_t expired) {
+        int index = expired & 1;
+        generations.clear(index);
+        for (std::uint64_t key : keysOf[index]) {
+            std::size_t slot = findSlot(key, mixKey(key));
+            if (slots[slot].epoch == expired) eraseSlot(slot);
+        }
+        keysOf[index].clear();
+    }
+
+    void rotateIfDue(std::int64_t nowNs) {
+        if (generationStartNs < 0) generationStartNs = nowNs;
+        for (int rotations = 0; nowNs - generationStartNs >= windowNs; ++rotations) {
+            if (rotations == 2) {
+                generationStartNs = nowNs; // both generations have expired already
+                break;
+            }
+            expireGeneration(epoch - 1);
+            ++epoch;
+            generationStartNs += windowNs;
+        }
+    }
+
+public:
+    RepeatCallerFilter(std::size_t expectedCallers, std::int64_t decayWindowNs)
+        : generations(expectedCallers, 2),
+          windowNs(decayWindowNs), slots(std::bit_ceil(std::max<std::size_t>(16, expectedCallers + expectedCallers / 3 + 1)), Slot{ 0, 0 }) {}
+
+    bool isRepeat(std::uint64_t key, std::int64_t nowNs = nowNanos()) {
+        rotateIfDue(nowNs);
+        ++queries;
+        std::uint64_t hash = mixKey(key);
+        if (!generations.mayContainInAnyLayer(hash)) return false;
+        ++filterPositives;
+        if (slots[findSlot(key, hash)].epoch) return true;
+        ++falsePositives;
+        return false;
+    }
+
+    // isRepeat for a batch of callers. The filter blocks are prefetched a few
+    // keys ahead, so a large batch overlaps its memory accesses instead of
+    // paying for each one in turn.
+    void isRepeat(const std::uint64_t* keys, std::size_t count, bool* repeats, std::int64_t nowNs = nowNanos()) {
+        constexpr std::size_t kPrefetchDistance = 16;
+        rotateIfDue(nowNs);
+        for (std::size_t i = 0; i < std::min(count, kPrefetchDistance); ++i) generations.prefetch(mixKey(keys[i]));
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i + kPrefetchDistance < count) generations.prefetch(mixKey(keys[i + kPrefetchDistance]));
+            repeats[i] = isRepeat(keys[i], nowNs);
+        }
+    }
+
+    // Notes a call from `key`, or refreshes it when the caller is already known.
+    void record(std::uint64_t key, std::int64_t nowNs = nowNanos()) {
+        rotateIfDue(nowNs);
+        std::uint64_t hash = mixKey(key);
+        std::size_t slot = findSlot(key, hash);
+        if (slots[slot].epoch == epoch) return;
+        if (!slots[slot].epoch) {
+            if (4 * (used + 1) > 3 * slots.size()) {
+                grow();
+                slot = findSlot(key, hash);
+            }
+            slots[slot].key = key;
+            ++used;
+        }
+        // A refreshed caller's counters in the older filter go when it expires.
+        slots[slot].epoch = epoch;
+        generations.insert(hash, epoch & 1);
+        keysOf[epoch & 1].push_back(key);
+    }
+
+    // The dedup check ahead of enqueue: true for a new caller (now recorded),
+    // false for a repeat.
+    bool admit(std::uint64_t key, std::int64_t nowNs = nowNanos()) {
+        bool repeat = isRepeat(key, nowNs);
+        record(key, nowNs);
+        return !repeat;
+    }
+
+    // The caller's call left the queue; their next call is new again.
+    void forget(std::uint64_t key) {
+        std::uint64_t hash = mixKey(key);
+        std::size_t slot = findSlot(key, hash);
+        if (!slots[slot].epoch) return;
+        generations.remove(hash, slots[slot].epoch & 1);
+        eraseSlot(slot);
+    }
+
+    // The exact check alone, without the filters in front of it.
+    bool containsExact(std::uint64_t key) const { return slots[findSlot(key, mixKey(key))].epoch != 0; }
+
+    std::size_t trackedCallers() const { return used; }
+    long long queryCount() const { return queries; }
+    long long filterPositiveCount() const { return filterPositives; }
+    long long falsePositiveCount() const { return falsePositives; }
+    std::size_t filterBytes() const { return generations.bytes(); }
+};
+
+// Many small call queues in one process, e.g. one per hosted call center.
+// Each tenant is a power-of-two ring of Calls. Rings are carved out of 2 MB
+// slabs per size class (8, 16, ... 4096 calls), so the rings of a class sit
+// together in a few large mappings instead of one heap allocation each.
+//
+// Creating and destroying a tenant is O(1):
+// - a free list per size class recycles rings;
+// - a free list of tenant ids recycles the 24-byte tenant headers.
+// Slabs are kept for reuse once mapped. A tenant's memory is its header plus
+// its ring; rounding the capacity up to a power of two is the only other
+// waste.
+//
+// Tenant ids are reused after destroyTenant, so a stale id may name a newer
+// tenant. An id that is not live is rejected: enqueue, dequeue and
+// destroyTenant return false, and size, capacityOf and memoryOf return 0.
+// Not thread-safe.
+class TenantQueueManager {
+public:
+    static constexpr int kMinClassBits = 3;  // 8 calls
+    static constexpr int kMaxClassBits = 12; // 4096 calls
+    static constexpr std::size_t kSlabBytes = 2 << 20;
+
+private:
+    struct TenantRing {
+        Call* slots;
+        std::uint32_t mask;
+        std::uint32_t head;      // free-running; slot is head & mask
+        std::uint32_t tail;
+        std::uint32_t nextFree;  // next free tenant id while this one is unused
+    };
+    static constexpr std::uint32_t kNoTenant = 0xFFFFFFFF;
+    static constexpr int kClassCount = kMaxClassBits - kMinClassBits + 1;
+
+    std::vector<TenantRing> tenants;
+    std::uint32_t freeTenants = kNoTenant;
+    std::vector<Call*> freeRings[kClassCount];
+    std::vector<std::pair<void*, std::size_t>> slabs;
+    std::size_t liveTenants = 0;
+
+    static int classFor(int capacity) {
+        int bits = kMinClassBits;
+        while ((1 << bits) < capacity) ++bits;
+        return bits - kMinClassBits;
+    }
+
+    // Maps a new slab for `sizeClass` and adds its rings to the free list.
+    bool addSlab(int sizeClass) {
+        std::size_t ringBytes = (std::size_t{ 1 } << (sizeClass + kMinClassBits)) * sizeof(Call);
+        std::size_t bytes = std::max(kSlabBytes, ringBytes);
+        void* mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) return false;
+        slabs.emplace_back(mapping, bytes);
+        char* base = static_cast<char*>(mapping);
+        std::vector<Call*>& rings = freeRings[sizeClass];
+        // Hand rings out from the start of the slab first.
+        for (std::size_t offset = bytes / ringBytes * ringBytes; offset > 0; offset -= ringBytes) {
+            rings.push_back(reinterpret_cast<Call*>(base + offset - ringBytes));
+        }
+        return true;
+    }
+
+public:
+    TenantQueueManager() = default;
+    TenantQueueManager(const TenantQueueManager&) = delete;
+    TenantQueueManager& operator=(const TenantQueueManager&) = delete;
+
+    ~TenantQueueManager() {
+        for (auto& [mapping, bytes] : slabs) ::munmap(mapping, bytes);
+    }
+
+    // New empty tenant queue holding at least `capacity` calls, or -1 if the
+    // capacity is beyond the largest size class or memory ran out.
+    int createTenant(int capacity) {
+        if (capacity < 1 || capacity > (1 << kMaxClassBits)) return -1;
+        int sizeClass = classFor(capacity);
+        if (freeRings[sizeClass].empty() && !addSlab(sizeClass)) return -1;
+        Call* slots = freeRings[sizeClass].back();
+        freeRings[sizeClass].pop_back();
+
+        std::uint32_t id = freeTenants;
+        if (id != kNoTenant) {
+            freeTenants = tenants[id].nextFree;
+        }
+        else {
+            id = static_cast<std::uint32_t>(tenants.size());
+            tenants.push_back({});
+        }
+        tenants[id] = TenantRing{ slots, (1u << (sizeClass + kMinClassBits)) - 1, 0, 0, kNoTenant };
+        ++liveTenants;
+        return static_cast<int>(id);
+    }
+
+    // True while `tenant` names a created, not yet destroyed tenant.
+    bool isLive(int tenant) const {
+        return tenant >= 0 && static_cast<std::size_t>(tenant) < tenants.size() && tenants[tenant].slots != nullptr;
+    }
+
+    // Releases the tenant's ring and id; any calls still waiting are dropped.
+    // Returns false, changing nothing, if `tenant` is not live.
+    bool destroyTenant(int tenant) {
+        if (!isLive(tenant)) return false;
+        TenantRing& ring = tenants[tenant];
+        freeRings[classFor(ring.mask + 1)].push_back(ring.slots);
+        ring.slots = nullptr;
+        ring.nextFree = freeTenants;
+        freeTenants = static_cast<std::uint32_t>(tenant);
+        --liveTenants;
+        return true;
+    }
+
+    bool enqueue(int tenant, const Call& call) {
+        if (!isLive(tenant)) [[unlikely]] return false;
+        TenantRing& ring = tenants[tenant];
+        if (ring.tail - ring.head > ring.mask) return false;
+        ring.slots[ring.tail++ & ring.mask] = call;
+        return true;
+    }
+
+    bool dequeue(int tenant, Call& out) {
+        if (!isLive(tenant)) [[unlikely]] return false;
+        TenantRing& ring = tenants[tenant];
+        if (ring.head == ring.tail) return false;
+        out = ring.slots[ring.head++ & ring.mask];
+        return true;
+    }
+
+    int size(int tenant) const {
+        return isLive(tenant) ? static_cast<int>(tenants[tenant].tail - tenants[tenant].head) : 0;
+    }
+    int capacityOf(int tenant) const { return isLive(tenant) ? static_cast<int>(tenants[tenant].mask + 1) : 0; }
+    std::size_t tenantCount() const { return liveTenants; }
+
+    // Bytes this tenant occupies: its header and its ring.
+    std::size_t memoryOf(int tenant) const {
+        if (!isLive(tenant)) return 0;
+        return sizeof(TenantRing) + static_cast<std::size_t>(capacityOf(tenant)) * sizeof(Call);
+    }
+
+    // Bytes mapped for rings plus tenant headers, used or not.
+    std::size_t reservedBytes() const {
+        std::size_t bytes = tenants.capacity() * sizeof(TenantRing);
+        for (const auto& slab : slabs) bytes += slab.second;
+        return bytes;
+    }
+
+    std::size_t slabCount() const { return slabs.size(); }
+};
+
+// Deficit round-robin across CircularQueues, e.g. one per tenant sharing an
+// agent pool. Each call costs its Call::duration (minutes, at least 1). While
+// backlogged, each queue receives agent time in proportion to its weight.
+//
+// Only queues with calls waiting are on the active list, a FIFO ring of queue
+// indices, so picking the next call never looks at idle queues. When a queue
+// reaches the head of the list, it gains quantum * weight of credit. It is
+// served while its credit covers the cost of its front call, then goes to
+// the back of the list. A queue that empties leaves the list and forfeits
+// its credit. With a quantum of at least the longest call, every visit
+// serves at least one call, so dequeue is O(1) amortized.
+//
+// Calls must be enqueued through the scheduler, or the queue activated
+// afterwards, so a queue that becomes non-empty joins the active list.
+class DeficitRoundRobin {
+private:
+    struct Member {
+        CircularQueue* queue;
+        std::int64_t quantum;
+        std::int64_t deficit = 0;
+        bool active = false;
+        bool credited = false; // received its quantum for the current visit
+    };
+
+    std::vector<Member> members;
+    std::vector<int> activeRing; // capacity is members.size()
+    std::size_t activeHead = 0;
+    std::size_t activeCount = 0;
+    std::int64_t quantum;
+
+    static std::int64_t costOf(const Call& call) { return std::max(call.duration, 1); }
+
+    void pushActive(int index) {
+        activeRing[(activeHead + activeCount) % activeRing.size()] = index;
+        ++activeCount;
+    }
+
+    int popActive() {
+        int index = activeRing[activeHead];
+        activeHead = (activeHead + 1) % activeRing.size();
+        --activeCount;
+        return index;
+    }
+
+public:
+    explicit DeficitRoundRobin(std::int64_t quantumMinutes = 60) : quantum(quantumMinutes) {}
+
+    // Adds `queue` with a share of service proportional to `weight`; returns its index.
+    int addQueue(CircularQueue& queue, double weight = 1) {
+        members.push_back(Member{ &queue, std::max<std::int64_t>(1, std::llround(quantum * weight)) });
+        // Grow the ring, keeping the active entries in order.
+        std::vector<int> ring(members.size());
+        for (std::size_t i = 0; i < activeCount; ++i) ring[i] = activeRing[(activeHead + i) % activeRing.size()];
+        activeRing.swap(ring);
+        activeHead = 0;
+        activate(static_cast<int>(members.size()) - 1);
+        return static_cast<int>(members.size()) - 1;
+    }
+
+    // Puts queue `index` on the active list if it has calls and is not on it.
+    void activate(int index) {
+        Member& member = members[index];
+        if (member.active || member.queue->isEmpty()) return;
+        member.active = true;
+        pushActive(index);
+    }
+
+    bool enqueue(int index, const Call& call) {
+        if (!members[index].queue->enqueue(call)) return false;
+        activate(index);
+        return true;
+    }
+
+    // Dequeues the next call in DRR order and reports which queue it came from.
+    bool dequeue(Call& out, int* fromQueue = nullptr) {
+        while (activeCount > 0) {
+            int index = activeRing[activeHead];
+            Member& member = members[index];
+            const Call* next = member.queue->peek();
+            if (!next) {
+                // Emptied behind the scheduler's back.
+                popActive();
+                member.active = member.credited = false;
+                member.deficit = 0;
+                continue;
+            }
+            if (!member.credited) {
+                member.deficit += member.quantum;
+                member.credited = true;
+            }
+            if (costOf(*next) <= member.deficit) {
+                member.deficit -= costOf(*next);
+                member.queue->dequeue(out);
+                if (fromQueue) *fromQueue = index;
+                if (member.queue->isEmpty()) {
+                    popActive();
+                    member.active = member.credited = false;
+                    member.deficit = 0;
+                }
+                return true;
+            }
+            // Out of credit for this visit: to the back of the list.
+            member.credited = false;
+            pushActive(popActive());
+        }
+        return false;
+    }
+
+    std::size_t queueCount() const { return members.size(); }
+    std::size_t activeQueues() const { return activeCount; }
+};
+
+// Which CPUs belong to which NUMA node. detect() reads the host's topology;
+// fake() describes an imaginary one so NUMA code paths can be exercised on a
+// single-node machine. Memory for a fake node is placed on real node
+// (node % realNodes).
+class NumaTopology {
+private:
+    std::vector<std::vector<int>> cpusOfNode;
+    int realNodes = 1;
+    bool fakeTopology = false;
+
+    static std::vector<int> parseCpuList(const std::string& text) {
+        std::vector<int> cpus;
+        std::size_t position = 0;
+        while (position < text.size()) {
+            char* end = nullptr;
+            long first = std::strtol(text.c_str() + position, &end, 10);
+            if (end == text.c_str() + position) break;
+            long last = first;
+            if (*end == '-') last = std::strtol(end + 1, &end, 10);
+            for (long cpu = first; cpu <= last; ++cpu) cpus.push_back(static_cast<int>(cpu));
+            position = end - text.c_str();
+            if (position < text.size() && text[position] == ',') ++position;
+            else break;
+        }
+        return cpus;
+    }
+
+public:
+    // The host's nodes from sysfs; one node with every CPU if that is unavailable.
+    static NumaTopology detect() {
+        NumaTopology topology;
+        for (int node = 0;; ++node) {
+            std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            FILE* file = std::fopen(path.c_str(), "r");
+            if (!file) break;
+            char buffer[1024] = {};
+            std::size_t length = std::fread(buffer, 1, sizeof(buffer) - 1, file);
+            std::fclose(file);
+            topology.cpusOfNode.push_back(parseCpuList(std::string(buffer, length)));
+        }
+        if (topology.cpusOfNode.empty()) {
+            std::vector<int> all;
+            for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) all.push_back(cpu);
+            topology.cpusOfNode.push_back(all);
+        }
+        topology.realNodes = static_cast<int>(topology.cpusOfNode.size());
+        return topology;
+    }
+
+    // `nodes` imaginary nodes that share the host's real ones. A count below 1
+    // is rejected: the host's topology is returned and isFake() is false.
+    static NumaTopology fake(int nodes) {
+        NumaTopology topology = detect();
+        if (nodes < 1) return topology;
+        std::vector<int> all;
+        for (const auto& cpus : topology.cpusOfNode) all.insert(all.end(), cpus.begin(), cpus.end());
+        topology.cpusOfNode.assign(nodes, {});
+        for (std::size_t i = 0; i < all.size(); ++i) topology.cpusOfNode[i % nodes].push_back(all[i]);
+        topology.fakeTopology = true;
+        return topology;
+    }
+
+    int nodeCount() const { return static_cast<int>(cpusOfNode.size()); }
+    bool isFake() const { return fakeTopology; }
+    const std::vector<int>& cpusOf(int node) const { return cpusOfNode[node]; }
+
+    // The real node backing `node`.
+    int physicalNode(int node) const { return fakeTopology ? node % realNodes : node; }
+
+    int nodeOfCpu(int cpu) const {
+        for (int node = 0; node < nodeCount(); ++node) {
+            const auto& cpus = cpusOfNode[node];
+            if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) return node;
+        }
+        return 0;
+    }
+
+    // Node of the CPU the calling thread is running on.
+    int currentNode() const {
+        int cpu = ::sched_getcpu();
+        return cpu < 0 ? 0 : nodeOfCpu(cpu);
+    }
+
+    // Pins the calling thread to the CPUs of `node`.
+    bool pinToNode(int node) const {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpusOfNode[node]) CPU_SET(cpu, &set);
+        return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+};
+
+// Anonymous memory placed on one NUMA node. The pages are bound to the
+// node with mbind(2), called through syscall() so libnuma is not needed, and
+// then touched so they are allocated right away. If binding fails (e.g. the
+// kernel has no NUMA support), the pages are still touched by the calling
+// thread, so first touch puts them on that thread's node.
+class NodeLocalMemory {
+private:
+    void* mapping = nullptr;
+    std::size_t length = 0;
+    bool bound = false;
+
+public:
+    NodeLocalMemory(std::size_t bytes, int physicalNode) : length(bytes) {
+        mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            return;
+        }
+        if (physicalNode >= 0) {
+            // A mask wide enough for any node number; the kernel drops the
+            // last bit of `maxnode`, hence the + 1.
+            constexpr int kBitsPerWord = sizeof(unsigned long) * 8;
+            std::vector<unsigned long> nodeMask(physicalNode / kBitsPerWord + 1, 0);
+            nodeMask.back() = 1ul << (physicalNode % kBitsPerWord);
+            const int kMpolBind = 2;
+            bound = ::syscall(SYS_mbind, mapping, length, kMpolBind, nodeMask.data(),
+                nodeMask.size() * kBitsPerWord + 1, 0) == 0;
+        }
+        std::memset(mapping, 0, length);
+    }
+
+    NodeLocalMemory(const NodeLocalMemory&) = delete;
+    NodeLocalMemory& operator=(const NodeLocalMemory&) = delete;
+
+    ~NodeLocalMemory() {
+        if (mapping) ::munmap(mapping, length);
+    }
+
+    void* data() const { return mapping; }
+    bool isBound() const { return bound; }
+};
+
+// A call queue with one shard per NUMA node, each a ring in memory on its own
+// node. Producers enqueue to the shard of the node the call should be served
+// on, usually their own. Consumers dequeue from their own node's shard, and
+// only when it is empty steal from the other nodes, in order starting from the
+// next node up. Call data therefore stays node-local unless agents would
+// otherwise sit idle.
+//
+// Each shard is guarded by its own spin lock on its own cache line, so nodes
+// only contend when stealing. Safe for any number of threads.
+class NumaShardedQueue {
+private:
+    struct alignas(64) Shard {
+        std::atomic<bool> locked{ false };
+        Call* ring = nullptr;
+        std::uint32_t mask = 0;
+        std::uint32_t head = 0;
+        std::uint32_t tail = 0;
+        std::atomic<std::uint64_t> localDequeues{ 0 };
+        std::atomic<std::uint64_t> stolenDequeues{ 0 }; // by other nodes' consumers
+
+        void lock() {
+            while (locked.exchange(true, std::memory_order_acquire)) {
+                while (locked.load(std::memory_order_relaxed)) std::this_thread::yield();
+            }
+        }
+        void unlock() { locked.store(false, std::memory_order_release); }
+
+        bool tryDequeue(Call& out) {
+            lock();
+            bool found = head != tail;
+            if (found) out = ring[head++ & mask];
+            unlock();
+            return found;
+        }
+    };
+
+    NumaTopology topology;
+    std::vector<std::unique_ptr<NodeLocalMemory>> memory;
+    std::unique_ptr<Shard[]> shards;
+    int nodes;
+
+public:
+    // `capacityPerNode` is rounded up to a power of two.
+    NumaShardedQueue(const NumaTopology& numaTopology, int capacityPerNode)
+        : topology(numaTopology), shards(new Shard[numaTopology.nodeCount()]), nodes(numaTopology.nodeCount()) {
+        std::uint32_t capacity = std::bit_ceil(static_cast<std::uint32_t>(std::max(capacityPerNode, 1)));
+        for (int node = 0; node < nodes; ++node) {
+            memory.push_back(std::make_unique<NodeLocalMemory>(capacity * sizeof(Call), topology.physicalNode(node)));
+            shards[node].ring = static_cast<Call*>(memory.back()->data());
+            shards[node].mask = capacity - 1;
+        }
+    }
+
+    int nodeCount() const { return nodes; }
+    const NumaTopology& getTopology() const { return topology; }
+
+    // True if every shard's ring is bound to its node, not just first-touched.
+    bool isNodeBound() const {
+        for (const auto& region : memory) {
+            if (!region->isBound()) return false;
+        }
+        return true;
+    }
+
+    bool enqueue(const Call& call, int node) {
+        Shard& shard = shards[node];
+        shard.lock();
+        bool fits = shard.tail - shard.head <= shard.mask;
+        if (fits) shard.ring[shard.tail++ & shard.mask] = call;
+        shard.unlock();
+        return fits;
+    }
+
+    // Next call for a consumer on `node`: local first, then stolen. Reports
+    // the node it came from.
+    bool dequeue(Call& out, int node, int* fromNode = nullptr) {
+        for (int offset = 0; offset < nodes; ++offset) {
+            int source = (node + offset) % nodes;
+            if (shards[source].tryDequeue(out)) {
+                (offset == 0 ? shards[source].localDequeues : shards[source].stolenDequeues)
+                    .fetch_add(1, std::memory_order_relaxed);
+                if (fromNode) *fromNode = source;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int size(int node) {
+        Shard& shard = shards[node];
+        shard.lock();
+        int count = static_cast<int>(shard.tail - shard.head);
+        shard.unlock();
+        return count;
+    }
+
+    std::uint64_t localDequeues(int node) const { return shards[node].localDequeues.load(std::memory_order_relaxed); }
+    std::uint64_t stolenDequeues(int node) const { return shards[node].stolenDequeues.load(std::memory_order_relaxed); }
+};
+
+// Measures the throughput cost of the write-ahead log at several group-commit
+// sizes against an unlogged queue, using alternating enqueue/dequeue pairs.
+void benchmarkWriteAheadLog() {
+    using Clock = std::chrono::steady_clock;
+    const std::string logPath = "bench_queue.wal";
+    const long long maxOps = 400000;
+    const double maxSeconds = 1.0;
+
+    auto run = [&](WriteAheadLog* wal) {
+        CircularQueue cq(1024);
+        cq.setVerbose(false);
+        cq.attachJournal(wal);
+        Call call = { 0, CallType::NORMAL, 10, false };
+        long long ops = 0;
+        auto start = Clock::now();
+        double seconds = 0;
+        while (ops < maxOps) {
+            call.callId = static_cast<int>(ops);
+            call.type = (ops & 7) == 0 ? CallType::EMERGENCY : CallType::NORMAL;
+            cq.enqueue(call);
+            cq.dequeue(call);
+            ops += 2;
+            if ((ops & 1023) == 0) {
+                seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                if (seconds >= maxSeconds) break;
+            }
+        }
+        if (wal) wal->sync();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return ops / seconds;
+    };
+
+    double baseline = run(nullptr);
+    std::cout << "group_commit,ops_per_sec,ns_per_op,overhead_ns_per_op,fsyncs\n";
+    std::cout << "none," << static_cast<long long>(baseline) << "," << 1e9 / baseline << ",0,0\n";
+    for (int groupSize : { 1, 8, 64, 512, 4096 }) {
+        std::remove(logPath.c_str());
+        double rate;
+        long long syncs;
+        {
+            WriteAheadLog wal(logPath, 1024, groupSize, 0);
+            rate = run(&wal);
+            syncs = wal.getSyncCount();
+        }
+        std::cout << groupSize << "," << static_cast<long long>(rate) << "," << 1e9 / rate << ","
+            << 1e9 / rate - 1e9 / baseline << "," << syncs << "\n";
+    }
+    std::remove(logPath.c_str());
+}
+
+// Fills a 10M-slot persistent ring, then times how long a new
+// PersistentCircularQueue takes to reattach to it and serve its first call.
+void benchmarkPersistentRing() {
+    using Clock = std::chrono::steady_clock;
+    const std::string ringPath = "bench_queue.ring";
+    const std::int64_t capacity = 10000000;
+    std::remove(ringPath.c_str());
+
+    auto fillStart = Clock::now();
+    {
+        PersistentCircularQueue ring(ringPath, capacity);
+        ring.setVerbose(false);
+        Call call = { 0, CallType::NORMAL, 10, false };
+        for (std::int64_t i = 0; i < capacity; ++i) {
+            call.callId = static_cast<int>(i);
+            call.type = (i & 7) == 0 ? CallType::EMERGENCY : CallType::NORMAL;
+            ring.enqueue(call);
+        }
+    }
+    double fillSeconds = std::chrono::duration<double>(Clock::now() - fillStart).count();
+
+    std::cout << "entries,fill_sec,attach_ms,first_dequeue_ms,recovered,size\n";
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        auto start = Clock::now();
+        PersistentCircularQueue ring(ringPath, capacity);
+        double attachMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        ring.setVerbose(false);
+        std::int64_t size = ring.size();
+        Call call;
+        ring.dequeue(call);
+        double firstMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << capacity << "," << fillSeconds << "," << attachMs << "," << firstMs << ","
+            << (ring.wasRecovered() ? "yes" : "no") << "," << size << "\n";
+    }
+    std::remove(ringPath.c_str());
+}
+
+// Streams calls from this process to a forked consumer through a
+// SharedCallQueue for throughput, then bounces a call back and forth over a
+// pair of queues for round-trip latency.
+void benchmarkSharedQueue() {
+    using Clock = std::chrono::steady_clock;
+    const long long streamCalls = 10000000;
+    const int pingPongs = 20000;
+
+    std::cout << "test,calls,seconds,calls_per_sec,ns_per_call\n";
+    {
+        SharedCallQueue cq("/telephone_queue_bench", 1 << 14);
+        pid_t child = ::fork();
+        if (child == 0) {
+            Call call;
+            for (long long received = 0; received < streamCalls; ++received) cq.waitDequeue(call);
+            ::_exit(0);
+        }
+        auto start = Clock::now();
+        Call call = { 0, CallType::NORMAL, 10, false };
+        for (long long sent = 0; sent < streamCalls; ++sent) {
+            call.callId = static_cast<int>(sent);
+            while (!cq.enqueue(call)) ::sched_yield();
+        }
+        ::waitpid(child, nullptr, 0);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << "throughput," << streamCalls << "," << seconds << ","
+            << static_cast<long long>(streamCalls / seconds) << "," << 1e9 * seconds / streamCalls << "\n";
+        cq.unlink();
+    }
+    {
+        SharedCallQueue request("/telephone_queue_bench_req", 64);
+        SharedCallQueue reply("/telephone_queue_bench_rep", 64);
+        pid_t child = ::fork();
+        if (child == 0) {
+            Call call;
+            for (int i = 0; i < pingPongs; ++i) {
+                request.waitDequeue(call, -1, 100);
+                reply.enqueue(call);
+            }
+            ::_exit(0);
+        }
+        auto start = Clock::now();
+        Call call = { 0, CallType::EMERGENCY, 5, true };
+        for (int i = 0; i < pingPongs; ++i) {
+            call.callId = i;
+            request.enqueue(call);
+            reply.waitDequeue(call, -1, 100);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        ::waitpid(child, nullptr, 0);
+        std::cout << "round_trip," << pingPongs << "," << seconds << ","
+            << static_cast<long long>(pingPongs / seconds) << "," << 1e9 * seconds / pingPongs << "\n";
+        request.unlink();
+        reply.unlink();
+    }
+}
+
+// Replicates a queue paced at one million operations per second to a forked
+// standby over a Unix socket and reports how far the standby lags behind.
+void benchmarkReplication() {
+    const double opsPerSecond = 1e6;
+    const double seconds = 2.0;
+    const long long totalOps = static_cast<long long>(opsPerSecond * seconds);
+
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return;
+    std::cout << "side,ops,seconds,ops_per_sec,lag_p50_us,lag_p99_us,lag_max_us\n" << std::flush;
+
+    pid_t child = ::fork();
+    if (child == 0) {
+        ::close(sv[0]);
+        CircularQueue replica(4096);
+        replica.setVerbose(false);
+        ReplicationFollower follower(sv[1], replica);
+        std::vector<std::int64_t> lags;
+        lags.reserve(totalOps / 16);
+        while (follower.applyNextBatch()) lags.push_back(follower.lastFrameLagNs());
+        std::sort(lags.begin(), lags.end());
+        auto percentile = [&](double p) {
+            return lags.empty() ? 0.0 : lags[static_cast<std::size_t>(p * (lags.size() - 1))] / 1000.0;
+        };
+        std::cout << "standby," << follower.lastApplied() << ",,," << percentile(0.5) << ","
+            << percentile(0.99) << "," << percentile(1.0) << "\n" << std::flush;
+        ::_exit(follower.hasDiverged() ? 1 : 0);
+    }
+    ::close(sv[1]);
+
+    CircularQueue cq(4096);
+    cq.setVerbose(false);
+    ReplicationLeader leader(sv[0], 16 * 1024, 200);
+    cq.attachJournal(&leader);
+
+    Call call = { 0, CallType::NORMAL, 10, false };
+    long long issued = 0;
+    std::int64_t start = nowNanos();
+    while (issued < totalOps) {
+        long long due = static_cast<long long>((nowNanos() - start) * opsPerSecond / 1e9);
+        if (due > totalOps) due = totalOps;
+        if (issued == due) {
+            leader.poll();
+            ::sched_yield();
+            continue;
+        }
+        while (issued < due) {
+            if (cq.size() < 2048) {
+                call.callId = static_cast<int>(issued);
+                call.type = (issued % 10) == 0 ? CallType::EMERGENCY : CallType::NORMAL;
+                cq.enqueue(call);
+            }
+            else if (issued % 4096 == 1) {
+                cq.cancel(call.callId);
+            }
+            else {
+                cq.dequeue(call);
+            }
+            ++issued;
+        }
+        leader.poll();
+    }
+    leader.handoff();
+    double elapsed = (nowNanos() - start) / 1e9;
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    ::close(sv[0]);
+    std::cout << "leader," << issued << "," << elapsed << "," << static_cast<long long>(issued / elapsed)
+        << ",,,\n";
+}
+
+// Discards everything written to it; lets display() be timed without a terminal.
+class NullStreamBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Keeps the compiler from optimizing away a benchmarked result.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct OperationSample {
+    long long ops = 0;
+    std::int64_t nanos = 0;
+    std::size_t allocations = 0;
+};
+
+// Times `body`, which returns how many operations it performed, and adds the
+// elapsed time and heap allocations to `sample`.
+template <typename Body>
+void timeOperations(OperationSample& sample, Body body) {
+    std::size_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+    std::int64_t start = nowNanos();
+    long long ops = body();
+    sample.nanos += nowNanos() - start;
+    sample.allocations += heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+    sample.ops += ops;
+}
+
+// Calls `round` until at least `minNanos` of operations have been timed.
+template <typename Round>
+OperationSample repeatRounds(Round round, std::int64_t minNanos = 50000000) {
+    OperationSample sample;
+    while (sample.nanos < minNanos) round(sample);
+    return sample;
+}
+
+// The emergency calls are spread evenly so that `ratio` of any prefix is EMERGENCY.
+inline Call benchmarkCall(long long i, double emergencyRatio) {
+    bool emergency = static_cast<long long>((i + 1) * emergencyRatio) != static_cast<long long>(i * emergencyRatio);
+    return { static_cast<int>(i), emergency ? CallType::EMERGENCY : CallType::NORMAL, static_cast<int>(1 + i % 30), (i & 1) != 0 };
+}
+
+// Leaves `cq` holding one call, either at slot 0 or (wrapped) in the middle
+// of the ring, so that filling it afterwards crosses the end of the ring.
+inline void resetQueuePosition(CircularQueue& cq, bool wrapped) {
+    Call call;
+    while (cq.dequeue(call)) {}
+    int advance = wrapped ? cq.getCapacity() / 2 : 1;
+    for (int i = 0; i < advance; ++i) cq.enqueue(benchmarkCall(i, 0.0));
+    for (int i = 1; i < advance; ++i) cq.dequeue(call);
+}
+
+inline void fillQueue(CircularQueue& cq, double emergencyRatio) {
+    for (long long i = cq.size(); !cq.isFull(); ++i) cq.enqueue(benchmarkCall(i, emergencyRatio));
+}
+
+// One JSON object per line, so results can be diffed and tracked between versions.
+inline void printBenchmarkResult(const char* name, int size, double emergencyRatio, bool wrapped, const OperationSample& sample) {
+    double nsPerOp = sample.ops ? static_cast<double>(sample.nanos) / sample.ops : 0.0;
+    std::cout << "{\"benchmark\":\"" << name << "\",\"size\":" << size << ",\"emergency_ratio\":" << emergencyRatio
+        << ",\"wrap\":\"" << (wrapped ? "wrapped" : "contiguous") << "\",\"ops\":" << sample.ops
+        << ",\"ns_per_op\":" << nsPerOp << ",\"ops_per_sec\":" << (nsPerOp > 0 ? 1e9 / nsPerOp : 0.0)
+        << ",\"allocs_per_op\":" << AllocationRate{ sample.allocations, static_cast<double>(sample.ops) } << "}\n";
+}
+
+// Microbenchmarks every CircularQueue operation across queue sizes,
+// emergency ratios and wrap states. Setup between rounds is not timed.
+void benchmarkCircularQueue() {
+    NullStreamBuffer nullBuffer;
+    for (int size : { 16, 1024, 65536, 1 << 20 }) {
+        CircularQueue cq(size);
+        cq.setVerbose(false);
+        for (double ratio : { 0.0, 0.1, 0.5 }) {
+            for (bool wrapped : { false, true }) {
+                OperationSample enqueue = repeatRounds([&](OperationSample& sample) {
+                    resetQueuePosition(cq, wrapped);
+                    timeOperations(sample, [&] {
+                        long long ops = 0;
+                        for (long long i = cq.size(); i < size; ++i, ++ops) cq.enqueue(benchmarkCall(i, ratio));
+                        return ops;
+                    });
+                });
+                printBenchmarkResult("enqueue", size, ratio, wrapped, enqueue);
+
+                OperationSample dequeue = repeatRounds([&](OperationSample& sample) {
+                    resetQueuePosition(cq, wrapped);
+                    fillQueue(cq, ratio);
+                    timeOperations(sample, [&] {
+                        long long ops = 0;
+                        Call call;
+                        while (cq.dequeue(call)) {
+                            doNotOptimize(call);
+                            ++ops;
+                        }
+                        return ops;
+                    });
+                });
+                printBenchmarkResult("dequeue", size, ratio, wrapped, dequeue);
+
+                resetQueuePosition(cq, wrapped);
+                for (int i = 0; i < size / 2; ++i) cq.enqueue(benchmarkCall(i, ratio));
+                OperationSample fullEmpty = repeatRounds([&](OperationSample& sample) {
+                    timeOperations(sample, [&] {
+                        for (int i = 0; i < 1000000; ++i) {
+                            bool full = cq.isFull();
+                            bool empty = cq.isEmpty();
+                            doNotOptimize(full);
+                            doNotOptimize(empty);
+                        }
+                        return 2000000LL;
+                    });
+                });
+                printBenchmarkResult("isFull_isEmpty", size, ratio, wrapped, fullEmpty);
+
+                OperationSample display = repeatRounds([&](OperationSample& sample) {
+                    resetQueuePosition(cq, wrapped);
+                    fillQueue(cq, ratio);
+                    std::streambuf* saved = std::cout.rdbuf(&nullBuffer);
+                    timeOperations(sample, [&] {
+                        cq.display();
+                        return 1LL;
+                    });
+                    std::cout.rdbuf(saved);
+                });
+                printBenchmarkResult("display", size, ratio, wrapped, display);
+
+                OperationSample prioritize = repeatRounds([&](OperationSample& sample) {
+                    resetQueuePosition(cq, wrapped);
+                    fillQueue(cq, ratio);
+                    timeOperations(sample, [&] {
+                        cq.prioritizeEmergencyCalls();
+                        return 1LL;
+                    });
+                });
+                printBenchmarkResult("prioritizeEmergencyCalls", size, ratio, wrapped, prioritize);
+            }
+        }
+    }
+}
+
+inline void printReplayReport(const std::string& queueName, const ReplayReport& report) {
+    std::cout << "{\"queue\":\"" << queueName << "\",\"operations\":" << report.operations
+        << ",\"seconds\":" << report.seconds << ",\"ops_per_sec\":" << report.opsPerSecond
+        << ",\"max_schedule_lag_us\":" << report.maxScheduleLagUs << ",\"skipped\":" << report.skipped << "}\n";
+    const char* names[3] = { "enqueue", "dequeue", "prioritize" };
+    const OperationLatency* summaries[3] = { &report.enqueue, &report.dequeue, &report.prioritize };
+    for (int kind = 0; kind < 3; ++kind) {
+        const OperationLatency& s = *summaries[kind];
+        std::cout << "{\"queue\":\"" << queueName << "\",\"op\":\"" << names[kind] << "\",\"count\":" << s.count
+            << ",\"failed\":" << s.failed << ",\"p50_ns\":" << s.p50 << ",\"p90_ns\":" << s.p90
+            << ",\"p99_ns\":" << s.p99 << ",\"p999_ns\":" << s.p999 << ",\"max_ns\":" << s.max << "}\n";
+    }
+}
+
+// replay <trace> [circular|persistent] [capacity] [paced]
+int replayCommand(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: TelephoneQueue replay <trace-file> [circular|persistent] [capacity] [paced]\n";
+        return 1;
+    }
+    std::vector<TraceRecord> trace;
+    if (!readTrace(args[1], trace)) {
+        std::cerr << "Cannot read trace " << args[1] << "\n";
+        return 1;
+    }
+    std::string queueName = args.size() > 2 ? args[2] : "circular";
+    int capacity = args.size() > 3 ? std::stoi(args[3]) : 1 << 20;
+    ReplayPace pace = args.size() > 4 && args[4] == "paced" ? ReplayPace::RECORDED : ReplayPace::FULL_SPEED;
+
+    if (queueName == "circular") {
+        CircularQueue cq(capacity);
+        cq.setVerbose(false);
+        printReplayReport(queueName, replayTrace(trace, cq, pace));
+    }
+    else if (queueName == "persistent") {
+        const std::string ringPath = "replay_queue.ring";
+        std::remove(ringPath.c_str());
+        {
+            PersistentCircularQueue ring(ringPath, capacity);
+            ring.setVerbose(false);
+            printReplayReport(queueName, replayTrace(trace, ring, pace));
+        }
+        std::remove(ringPath.c_str());
+    }
+    else {
+        std::cerr << "Unknown queue " << queueName << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+inline bool parseArrivalModel(const std::string& name, ArrivalModel& model) {
+    if (name == "poisson") model = ArrivalModel::POISSON;
+    else if (name == "mmpp") model = ArrivalModel::MMPP;
+    else if (name == "diurnal") model = ArrivalModel::DIURNAL;
+    else return false;
+    return true;
+}
+
+// Runs one generator per hardware thread for each arrival model and reports
+// the combined generation rate.
+void benchmarkLoadGenerator() {
+    int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const std::int64_t runNanos = 1000000000;
+    std::cout << "model,threads,calls,seconds,calls_per_sec,simulated_calls_per_sec\n";
+    for (const char* name : { "poisson", "mmpp", "diurnal" }) {
+        LoadProfile profile;
+        parseArrivalModel(name, profile.arrivals);
+        profile.callsPerSecond = 1e6;
+        profile.diurnalPeriodSeconds = 60;
+
+        std::vector<long long> generated(threadCount);
+        std::vector<std::int64_t> simulatedNs(threadCount);
+        std::vector<std::thread> threads;
+        std::int64_t start = nowNanos();
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t] {
+                CallLoadGenerator generator(profile, 42, t, threadCount);
+                Call calls[1024];
+                std::int64_t arrivals[1024];
+                long long count = 0;
+                while (nowNanos() - start < runNanos) {
+                    for (int batch = 0; batch < 64; ++batch) {
+                        generator.generate(calls, arrivals, 1024);
+                        doNotOptimize(calls);
+                    }
+                    count += 64 * 1024;
+                }
+                generated[t] = count;
+                simulatedNs[t] = arrivals[1023];
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        double seconds = (nowNanos() - start) / 1e9;
+        long long total = 0;
+        double simulatedRate = 0;
+        for (int t = 0; t < threadCount; ++t) {
+            total += generated[t];
+            simulatedRate += generated[t] / (simulatedNs[t] / 1e9);
+        }
+        std::cout << name << "," << threadCount << "," << total << "," << seconds << ","
+            << static_cast<long long>(total / seconds) << "," << static_cast<long long>(simulatedRate) << "\n";
+    }
+}
+
+// generate-trace <path> <poisson|mmpp|diurnal> <calls> [calls/s] [emergency ratio] [dequeues/s]
+int generateTraceCommand(const std::vector<std::string>& args) {
+    LoadProfile profile;
+    if (args.size() < 4 || !parseArrivalModel(args[2], profile.arrivals)) {
+        std::cerr << "Usage: TelephoneQueue generate-trace <trace-file> <poisson|mmpp|diurnal> <calls>"
+            " [calls-per-sec] [emergency-ratio] [dequeues-per-sec]\n";
+        return 1;
+    }
+    long long count = std::stoll(args[3]);
+    if (args.size() > 4) profile.callsPerSecond = std::stod(args[4]);
+    if (args.size() > 5) profile.emergencyRatio = std::stod(args[5]);
+    double dequeueRate = args.size() > 6 ? std::stod(args[6]) : profile.callsPerSecond;
+    if (!profile.isValid() || count < 0 || dequeueRate < 0) {
+        std::cerr << "generate-trace: calls-per-sec must be positive and emergency-ratio within [0, 1]\n";
+        return 1;
+    }
+    CallLoadGenerator generator(profile, 42);
+    if (!generator.writeTrace(args[1], count, dequeueRate)) {
+        std::cerr << "Cannot write trace " << args[1] << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+inline void printWaitTimes(const char* label, const LatencyHistogram& h) {
+    std::cout << "{\"type\":\"" << label << "\",\"count\":" << h.count() << ",\"p50_ns\":" << h.percentile(0.5)
+        << ",\"p90_ns\":" << h.percentile(0.9) << ",\"p99_ns\":" << h.percentile(0.99)
+        << ",\"p999_ns\":" << h.percentile(0.999) << ",\"max_ns\":" << h.max() << "}\n";
+}
+
+// Measures the cost of recording a wait time from one and from several
+// threads, and of merging a snapshot while they record.
+void benchmarkWaitHistograms() {
+    const long long perThread = 20000000;
+    int threadCount = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "{\"benchmark\":\"histogram_layout\",\"buckets\":" << LatencyHistogram::kBucketCount
+        << ",\"bytes_per_thread\":" << 2 * LatencyHistogram::kBucketCount * sizeof(std::uint64_t) << "}\n";
+    for (int threads : { 1, threadCount }) {
+        WaitTimeRecorder recorder;
+        std::atomic<bool> done{ false };
+        long long snapshots = 0;
+        std::int64_t snapshotNanos = 0;
+        std::thread reader([&] {
+            while (!done.load()) {
+                std::int64_t start = nowNanos();
+                LatencyHistogram interval = recorder.intervalSnapshot(CallType::NORMAL);
+                doNotOptimize(interval.counts[0]);
+                snapshotNanos += nowNanos() - start;
+                ++snapshots;
+                ::usleep(1000);
+            }
+        });
+        std::vector<std::thread> writers;
+        std::int64_t start = nowNanos();
+        for (int t = 0; t < threads; ++t) {
+            writers.emplace_back([&, t] {
+                FastRandom random(t + 1);
+                for (long long i = 0; i < perThread; ++i) {
+                    recorder.record((i & 7) ? CallType::NORMAL : CallType::EMERGENCY,
+                        static_cast<std::int64_t>(random.next() >> 40));
+                }
+            });
+        }
+        for (auto& writer : writers) writer.join();
+        double seconds = (nowNanos() - start) / 1e9;
+        done = true;
+        reader.join();
+        std::cout << "{\"benchmark\":\"record\",\"threads\":" << threads << ",\"records\":" << perThread * threads
+            << ",\"ns_per_record_per_thread\":" << 1e9 * seconds / perThread
+            << ",\"records_per_sec\":" << perThread * threads / seconds
+            << ",\"snapshot_us\":" << (snapshots ? snapshotNanos / 1000.0 / snapshots : 0.0) << "}\n";
+    }
+
+    // Wait times seen by calls in a queue fed faster than it is drained.
+    WaitTimeRecorder recorder;
+    CircularQueue cq(1 << 16);
+    cq.setVerbose(false);
+    cq.attachWaitRecorder(&recorder);
+    LoadProfile profile;
+    CallLoadGenerator generator(profile, 7);
+    Call call;
+    for (int round = 0; round < 200; ++round) {
+        generator.feed(cq, 1000);
+        for (int i = 0; i < 900; ++i) cq.dequeue(call);
+    }
+    printWaitTimes("NORMAL", recorder.snapshot(CallType::NORMAL));
+    printWaitTimes("EMERGENCY", recorder.snapshot(CallType::EMERGENCY));
+}
+
+// Compares the enqueue/dequeue fast path with and without QueueMetrics
+// attached to show the instrumentation overhead per operation.
+void benchmarkQueueMetrics() {
+    const long long pairs = 50000000;
+    auto run = [&](QueueMetrics* queueMetrics) {
+        CircularQueue cq(1024);
+        cq.setVerbose(false);
+        cq.attachMetrics(queueMetrics);
+        Call call = { 0, CallType::NORMAL, 10, false };
+        for (int i = 0; i < 512; ++i) cq.enqueue(call);
+        std::int64_t start = nowNanos();
+        for (long long i = 0; i < pairs; ++i) {
+            call.type = (i & 7) ? CallType::NORMAL : CallType::EMERGENCY;
+            cq.enqueue(call);
+            cq.dequeue(call);
+        }
+        return static_cast<double>(nowNanos() - start) / (2 * pairs);
+    };
+    // Interleave the runs so frequency changes affect both alike.
+    double plain = 0, instrumented = 0;
+    for (int round = 0; round < 3; ++round) {
+        plain += run(nullptr) / 3;
+        QueueMetrics metrics("bench");
+        instrumented += run(&metrics) / 3;
+    }
+    std::cout << "{\"benchmark\":\"metrics_overhead\",\"plain_ns_per_op\":" << plain
+        << ",\"instrumented_ns_per_op\":" << instrumented
+        << ",\"overhead_ns_per_op\":" << instrumented - plain << "}\n";
+
+    QueueMetrics metrics("bench");
+    CircularQueue cq(1 << 16);
+    cq.setVerbose(false);
+    cq.attachMetrics(&metrics);
+    LoadProfile profile;
+    CallLoadGenerator generator(profile, 11);
+    generator.feed(cq, 100000);
+    std::int64_t start = nowNanos();
+    std::string text = metrics.prometheusText();
+    std::cout << "{\"benchmark\":\"prometheus_snapshot\",\"us\":" << (nowNanos() - start) / 1000.0
+        << ",\"bytes\":" << text.size() << "}\n";
+}
+
+// Measures the enqueue/dequeue cost with lifecycle tracing off and on, and
+// exports the traced run as a Chrome trace.
+void benchmarkLifecycleTracing() {
+    const long long pairs = 20000000;
+    auto run = [&] {
+        CircularQueue cq(1024);
+        cq.setVerbose(false);
+        Call call = { 0, CallType::NORMAL, 10, false };
+        for (int i = 0; i < 512; ++i) cq.enqueue(call);
+        std::int64_t start = nowNanos();
+        for (long long i = 0; i < pairs; ++i) {
+            call.callId = static_cast<int>(i);
+            call.type = (i & 7) ? CallType::NORMAL : CallType::EMERGENCY;
+            cq.enqueue(call);
+            cq.dequeue(call);
+        }
+        return static_cast<double>(nowNanos() - start) / (2 * pairs);
+    };
+
+    double disabled = run();
+    LifecycleTracer tracer;
+    tracer.start();
+    double enabled = run();
+    tracer.stop();
+
+    std::uint64_t ticks = readTimestampCounter();
+    std::int64_t ns = nowNanos();
+    ::usleep(100000);
+    double ticksPerNs = static_cast<double>(readTimestampCounter() - ticks) / (nowNanos() - ns);
+
+    const std::string path = "lifecycle_trace.json";
+    std::int64_t start = nowNanos();
+    tracer.exportChromeTrace(path);
+    double exportMs = (nowNanos() - start) / 1e6;
+    std::cout << "{\"benchmark\":\"lifecycle_tracing\",\"disabled_ns_per_op\":" << disabled
+        << ",\"enabled_ns_per_op\":" << enabled << ",\"tsc_ghz\":" << ticksPerNs
+        << ",\"events_exported\":" << tracer.events().size() << ",\"export_ms\":" << exportMs
+        << ",\"trace_file\":\"" << path << "\"}\n";
+}
+
+inline void printDispatchSimulation(const char* mode, double parameter, const DispatchSimulation& sim) {
+    auto seconds = [](double ns) { return ns / 1e9; };
+    std::cout << mode << "," << parameter
+        << "," << seconds(sim.meanWaitNs[0]) << "," << seconds(sim.waits[0].percentile(0.99)) << "," << seconds(sim.waits[0].max())
+        << "," << seconds(sim.meanWaitNs[1]) << "," << seconds(sim.waits[1].percentile(0.99)) << "," << seconds(sim.waits[1].max())
+        << "\n";
+}
+
+// Latency trade-off between NORMAL and EMERGENCY calls under emergency
+// surges: strict emergency-first, then aging with a shrinking EMERGENCY head
+// start, then weighted fair queuing with a shrinking EMERGENCY weight.
+void simulateAgingTradeoff() {
+    const int agents = 20;
+    auto arrivals = surgeArrivals(24 * 14, 200, 30, 6, 2024);
+    std::cout << "mode,parameter,normal_mean_s,normal_p99_s,normal_max_s,emergency_mean_s,emergency_p99_s,emergency_max_s\n";
+
+    SchedulerPolicy strict;
+    strict.mode = DispatchMode::EMERGENCY_FIRST;
+    CallScheduler strictScheduler(1 << 20, strict);
+    printDispatchSimulation("emergency_first", 0, simulateDispatch(strictScheduler, arrivals, agents));
+
+    for (double headStart : { 3600.0, 1800.0, 900.0, 600.0, 300.0, 120.0, 0.0 }) {
+        SchedulerPolicy aging;
+        aging.mode = DispatchMode::AGING;
+        aging.basePriority[1] = headStart;
+        CallScheduler scheduler(1 << 20, aging);
+        printDispatchSimulation("aging_head_start_s", headStart, simulateDispatch(scheduler, arrivals, agents));
+    }
+    for (double weight : { 32.0, 16.0, 8.0, 4.0, 2.0, 1.0 }) {
+        SchedulerPolicy fair;
+        fair.mode = DispatchMode::WEIGHTED_FAIR;
+        fair.weight[1] = weight;
+        CallScheduler scheduler(1 << 20, fair);
+        printDispatchSimulation("wfq_emergency_weight", weight, simulateDispatch(scheduler, arrivals, agents));
+    }
+}
+
+// Steady-state cost of EDF dispatch: one dequeue plus one enqueue with a
+// random deadline, at several queue depths.
+void benchmarkDeadlineScheduler() {
+    for (int depth : { 1024, 65536, 1 << 20 }) {
+        DeadlineScheduler scheduler(depth + 1);
+        FastRandom random(depth);
+        Call call = { 0, CallType::NORMAL, 5, false };
+        for (int i = 0; i < depth; ++i) {
+            call.callId = i;
+            call.deadlineNs = static_cast<std::int64_t>(random.next() >> 24);
+            scheduler.enqueue(call, 0);
+        }
+        OperationSample sample = repeatRounds([&](OperationSample& round) {
+            timeOperations(round, [&] {
+                const int pairs = 100000;
+                Call out{};
+                for (int i = 0; i < pairs; ++i) {
+                    scheduler.dequeue(out, 0);
+                    // Later arrivals get later deadlines on average, as with a real SLA.
+                    out.deadlineNs += static_cast<std::int64_t>(random.next() >> 24);
+                    scheduler.enqueue(out, 0);
+                }
+                return static_cast<long long>(pairs);
+            });
+        });
+        std::cout << "{\"benchmark\":\"edf_dequeue_enqueue\",\"queued\":" << depth << ",\"ops\":" << sample.ops
+            << ",\"ns_per_op\":" << static_cast<double>(sample.nanos) / sample.ops
+            << ",\"allocs_per_op\":" << AllocationRate{ sample.allocations, static_cast<double>(sample.ops) } << "}\n";
+    }
+}
+
+// Missed SLA deadlines on the same surge arrivals under FIFO, emergency-first,
+// aging and EDF dispatch.
+void simulateDeadlines() {
+    const int agents = 20;
+    SlaPolicy sla;
+    sla.answerWithinNs[0] = 60 * 1000000000LL;
+    sla.answerWithinNs[1] = 20 * 1000000000LL;
+    auto arrivals = surgeArrivals(24 * 14, 200, 30, 6, 2024);
+    applySlaDeadlines(arrivals, sla);
+
+    std::cout << "mode,normal_calls,normal_missed,emergency_calls,emergency_missed,missed_pct,normal_p99_s,emergency_p99_s\n";
+    auto print = [](const char* mode, const DispatchSimulation& sim) {
+        long long calls = sim.waits[0].count() + sim.waits[1].count();
+        std::cout << mode << "," << sim.waits[0].count() << "," << sim.missedDeadlines[0]
+            << "," << sim.waits[1].count() << "," << sim.missedDeadlines[1]
+            << "," << (calls ? 100.0 * (sim.missedDeadlines[0] + sim.missedDeadlines[1]) / calls : 0.0)
+            << "," << sim.waits[0].percentile(0.99) / 1e9 << "," << sim.waits[1].percentile(0.99) / 1e9 << "\n";
+    };
+    for (DispatchMode mode : { DispatchMode::FIFO, DispatchMode::EMERGENCY_FIRST, DispatchMode::AGING }) {
+        SchedulerPolicy policy;
+        policy.mode = mode;
+        CallScheduler scheduler(1 << 20, policy);
+        print(mode == DispatchMode::FIFO ? "fifo" : mode == DispatchMode::AGING ? "aging" : "emergency_first",
+            simulateDispatch(scheduler, arrivals, agents));
+    }
+    DeadlineScheduler edf(1 << 20, sla);
+    print("edf", simulateDispatch(edf, arrivals, agents));
+}
+
+// Mean and tail wait under shortest-expected-duration-first dispatch, with
+// and without starvation bounds, against FIFO on the same surge arrivals.
+void simulateShortestFirst() {
+    const int agents = 20;
+    const std::int64_t second = 1000000000LL;
+    auto arrivals = surgeArrivals(24 * 14, 200, 30, 6, 2024);
+    std::cout << "mode,starvation_bound_s,mean_wait_s,normal_mean_s,normal_p99_s,normal_max_s,emergency_mean_s,emergency_p99_s,emergency_max_s\n";
+    auto print = [](const char* mode, double bound, const DispatchSimulation& sim) {
+        double normalCount = sim.waits[0].count(), emergencyCount = sim.waits[1].count();
+        double mean = (sim.meanWaitNs[0] * normalCount + sim.meanWaitNs[1] * emergencyCount) / (normalCount + emergencyCount);
+        std::cout << mode << "," << bound << "," << mean / 1e9
+            << "," << sim.meanWaitNs[0] / 1e9 << "," << sim.waits[0].percentile(0.99) / 1e9 << "," << sim.waits[0].max() / 1e9
+            << "," << sim.meanWaitNs[1] / 1e9 << "," << sim.waits[1].percentile(0.99) / 1e9 << "," << sim.waits[1].max() / 1e9 << "\n";
+    };
+
+    for (DispatchMode mode : { DispatchMode::FIFO, DispatchMode::EMERGENCY_FIRST }) {
+        SchedulerPolicy policy;
+        policy.mode = mode;
+        CallScheduler scheduler(1 << 20, policy);
+        print(mode == DispatchMode::FIFO ? "fifo" : "emergency_first", 0, simulateDispatch(scheduler, arrivals, agents));
+    }
+    ShortestFirstScheduler unbounded(1 << 20);
+    print("shortest_first", 0, simulateDispatch(unbounded, arrivals, agents));
+    for (int boundSeconds : { 300, 120, 60, 30 }) {
+        ShortestFirstScheduler bounded(1 << 20, boundSeconds * second);
+        print("shortest_first_bounded", boundSeconds, simulateDispatch(bounded, arrivals, agents));
+    }
+}
+
+// Enqueue/dequeue overhead of keeping a WaitEstimator current, and the cost of
+// one estimate against walking a full queue to sum the durations ahead.
+void benchmarkWaitEstimator() {
+    const long long pairs = 20000000;
+    auto run = [&](WaitEstimator* estimator) {
+        CircularQueue cq(1024);
+        cq.setVerbose(false);
+        cq.attachWaitEstimator(estimator);
+        Call call = { 0, CallType::NORMAL, 10, false };
+        for (int i = 0; i < 512; ++i) cq.enqueue(call);
+        std::int64_t start = nowNanos();
+        for (long long i = 0; i < pairs; ++i) {
+            call.type = (i & 7) ? CallType::NORMAL : CallType::EMERGENCY;
+            cq.enqueue(call);
+            cq.dequeue(call);
+        }
+        return static_cast<double>(nowNanos() - start) / (2 * pairs);
+    };
+    double plain = 0, estimated = 0;
+    for (int round = 0; round < 3; ++round) {
+        plain += run(nullptr) / 3;
+        WaitEstimator estimator(20);
+        estimated += run(&estimator) / 3;
+    }
+    std::cout << "{\"benchmark\":\"wait_estimator_overhead\",\"plain_ns_per_op\":" << plain
+        << ",\"estimated_ns_per_op\":" << estimated
+        << ",\"overhead_ns_per_op\":" << estimated - plain << "}\n";
+
+    WaitEstimator estimator(20);
+    CircularQueue cq(1 << 16);
+    cq.setVerbose(false);
+    cq.attachWaitEstimator(&estimator);
+    LoadProfile profile;
+    CallLoadGenerator generator(profile, 13);
+    std::vector<Call> calls((1 << 16) - 1);
+    std::vector<std::int64_t> arrivals(calls.size());
+    generator.generate(calls.data(), arrivals.data(), static_cast<int>(calls.size()));
+    for (const Call& call : calls) cq.enqueue(call);
+
+    const long long queries = 10000000;
+    std::int64_t start = nowNanos();
+    for (long long i = 0; i < queries; ++i) {
+        doNotOptimize(estimator.estimatedWaitNs((i & 1) ? CallType::NORMAL : CallType::EMERGENCY));
+    }
+    double estimateNs = static_cast<double>(nowNanos() - start) / queries;
+
+    // The walk it replaces: summing the durations of every queued call.
+    const int walks = 1000;
+    start = nowNanos();
+    for (int i = 0; i < walks; ++i) {
+        std::int64_t minutes = 0;
+        for (const Call& call : calls) minutes += call.duration;
+        doNotOptimize(minutes);
+    }
+    double walkNs = static_cast<double>(nowNanos() - start) / walks;
+    std::cout << "{\"benchmark\":\"wait_estimate_query\",\"queued\":" << cq.size() << ",\"estimate_ns\":" << estimateNs
+        << ",\"ring_walk_ns\":" << walkNs << "}\n";
+}
+
+// Position queries at 1M queued calls, the enqueue/dequeue cost of keeping
+// the index current, and the rebuild after prioritizeEmergencyCalls.
+void benchmarkPositionIndex() {
+    const int queued = 1 << 20;
+    CircularQueue cq(queued + 1);
+    cq.setVerbose(false);
+    QueuePositionIndex index;
+    cq.attachPositionIndex(&index);
+    LoadProfile profile;
+    CallLoadGenerator generator(profile, 17);
+    // Start mid-ring so the queue wraps.
+    for (int i = 0; i < queued / 2; ++i) cq.enqueue(Call{ -1, CallType::NORMAL, 1, false });
+    for (int i = 0; i < queued / 2; ++i) cq.dequeue();
+    generator.feed(cq, queued);
+
+    FastRandom random(5);
+    const long long queries = 2000000;
+    std::int64_t start = nowNanos();
+    for (long long i = 0; i < queries; ++i) {
+        doNotOptimize(index.durationAhead(1 + static_cast<int>(random.next() % queued)));
+    }
+    double byCallNs = static_cast<double>(nowNanos() - start) / queries;
+    start = nowNanos();
+    for (long long i = 0; i < queries; ++i) {
+        doNotOptimize(index.durationAheadOfRank(static_cast<int>(random.next() % queued)));
+    }
+    double byRankNs = static_cast<double>(nowNanos() - start) / queries;
+    std::cout << "{\"benchmark\":\"position_query\",\"queued\":" << cq.size()
+        << ",\"duration_ahead_by_call_ns\":" << byCallNs << ",\"duration_ahead_by_rank_ns\":" << byRankNs << "}\n";
+
+    auto churn = [&](QueuePositionIndex* attached) {
+        cq.attachPositionIndex(attached);
+        const long long pairs = 1000000;
+        Call call;
+        std::int64_t begin = nowNanos();
+        for (long long i = 0; i < pairs; ++i) {
+            cq.dequeue(call);
+            cq.enqueue(call);
+        }
+        return static_cast<double>(nowNanos() - begin) / (2 * pairs);
+    };
+    double plain = churn(nullptr);
+    double indexed = churn(&index);
+    std::cout << "{\"benchmark\":\"position_index_overhead\",\"queued\":" << cq.size() << ",\"plain_ns_per_op\":" << plain
+        << ",\"indexed_ns_per_op\":" << indexed << ",\"overhead_ns_per_op\":" << indexed - plain << "}\n";
+
+    start = nowNanos();
+    cq.prioritizeEmergencyCalls();
+    std::cout << "{\"benchmark\":\"prioritize_with_index\",\"queued\":" << cq.size()
+        << ",\"ms\":" << (nowNanos() - start) / 1e6 << "}\n";
+}
+
+// Producer and consumer coroutines passing calls through a small queue, so
+// nearly every operation suspends one side and resumes the other.
+void benchmarkAsyncQueue() {
+    for (int capacity : { 1, 4, 64 }) {
+        CircularQueue cq(capacity);
+        cq.setVerbose(false);
+        EventLoop loop;
+        AsyncCallQueue calls(cq, loop);
+        const int count = 2000000;
+        long long callIdSum = 0;
+
+        // Warm-up round grows the loop's buffers to their peak.
+        loop.spawn(answerCalls(calls, 1000, false, callIdSum));
+        loop.spawn(produceCalls(calls, 1, 1000, false));
+        loop.run();
+
+        loop.spawn(answerCalls(calls, count, false, callIdSum));
+        loop.spawn(produceCalls(calls, 1, count, false));
+        std::size_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+        std::int64_t start = nowNanos();
+        long long resumptions = loop.run();
+        double nanos = static_cast<double>(nowNanos() - start);
+        std::size_t allocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+        doNotOptimize(callIdSum);
+        std::cout << "{\"benchmark\":\"async_queue_handoff\",\"capacity\":" << capacity << ",\"calls\":" << count
+            << ",\"resumptions\":" << resumptions << ",\"ns_per_call\":" << nanos / count
+            << ",\"allocs_per_call\":" << AllocationRate{ allocations, static_cast<double>(count) } << "}\n";
+    }
+}
+
+// Offers MMPP traffic at twice the answer rate to each shedding policy and
+// reports what was admitted, evicted and rejected per CallType, plus the cost
+// of one admission decision.
+void simulateOverload() {
+    const int capacity = 1000;
+    const double answersPerSecond = 500;
+    LoadProfile profile;
+    profile.arrivals = ArrivalModel::MMPP;
+    profile.callsPerSecond = 1000;
+    profile.burstMultiplier = 4;
+    profile.meanCalmSeconds = 20;
+    profile.meanBurstSeconds = 5;
+    profile.emergencyRatio = 0.1;
+    const int offered = 2000000;
+
+    CallLoadGenerator generator(profile, 21);
+    std::vector<Call> calls(offered);
+    std::vector<std::int64_t> arrivals(offered);
+    generator.generate(calls.data(), arrivals.data(), offered);
+
+    struct Named { const char* name; AdmissionPolicy policy; };
+    AdmissionPolicy dropIncoming, rejectNormal, evictNewest, evictOldest, earlyDrop;
+    dropIncoming.mode = ShedPolicy::DROP_INCOMING;
+    rejectNormal.mode = ShedPolicy::REJECT_NORMAL;
+    rejectNormal.emergencyReserve = capacity / 10;
+    evictNewest.mode = ShedPolicy::EVICT_NEWEST_NORMAL;
+    evictOldest.mode = ShedPolicy::EVICT_OLDEST_NORMAL;
+    earlyDrop.mode = ShedPolicy::EARLY_DROP;
+
+    for (const Named& named : { Named{ "drop_incoming", dropIncoming }, Named{ "reject_normal", rejectNormal },
+                                Named{ "evict_newest_normal", evictNewest }, Named{ "evict_oldest_normal", evictOldest },
+                                Named{ "early_drop", earlyDrop } }) {
+        AdmissionController controller(capacity, named.policy);
+        long long answerSlots = 0;
+        Call out;
+        for (int i = 0; i < offered; ++i) {
+            // Agents answer at a steady rate; a slot with nobody waiting is lost.
+            for (long long due = static_cast<long long>(arrivals[i] * answersPerSecond / 1e9); answerSlots < due; ++answerSlots) {
+                controller.dequeue(out);
+            }
+            controller.offer(calls[i]);
+        }
+
+        std::cout << "{\"simulation\":\"overload\",\"policy\":\"" << named.name << "\",\"offered\":" << offered;
+        for (CallType type : { CallType::NORMAL, CallType::EMERGENCY }) {
+            const char* prefix = type == CallType::NORMAL ? "normal" : "emergency";
+            long long admitted = controller.outcomeCount(AdmissionOutcome::ADMITTED, type)
+                + controller.outcomeCount(AdmissionOutcome::ADMITTED_AFTER_EVICTION, type);
+            long long rejected = controller.outcomeCount(AdmissionOutcome::REJECTED_FULL, type)
+                + controller.outcomeCount(AdmissionOutcome::REJECTED_SHED, type)
+                + controller.outcomeCount(AdmissionOutcome::REJECTED_EARLY_DROP, type);
+            std::cout << ",\"" << prefix << "_admitted\":" << admitted << ",\"" << prefix << "_rejected\":" << rejected;
+        }
+        std::cout << ",\"normal_evicted\":" << controller.evictedCount();
+
+        // Decision cost while saturated, the case shedding exists for.
+        const int decisions = 1000000;
+        std::int64_t start = nowNanos();
+        for (int i = 0; i < decisions; ++i) doNotOptimize(controller.offer(calls[i]).depth);
+        double nsPerDecision = static_cast<double>(nowNanos() - start) / decisions;
+        std::cout << ",\"ns_per_decision\":" << nsPerDecision << "}\n";
+    }
+}
+
+// Repeat-caller filter from cache-resident sizes up to 10M distinct callers:
+// record cost, lookups of absent and present callers, the false positive
+// rate, and the exact table lookup the filter saves for absent callers.
+void benchmarkRepeatCallerFilter() {
+    const std::uint64_t firstNumber = 15550000000ull;
+    for (std::uint64_t callers : { 100000ull, 1000000ull, 10000000ull }) {
+        RepeatCallerFilter filter(callers, 3600 * 1000000000LL);
+        auto perCaller = [&](std::int64_t start) { return static_cast<double>(nowNanos() - start) / callers; };
+
+        std::int64_t start = nowNanos();
+        for (std::uint64_t i = 0; i < callers; ++i) filter.record(firstNumber + i, 0);
+        double recordNs = perCaller(start);
+
+        long long repeats = 0;
+        start = nowNanos();
+        for (std::uint64_t i = 0; i < callers; ++i) repeats += filter.isRepeat(firstNumber + callers + i, 0);
+        double absentNs = perCaller(start);
+        long long falsePositives = filter.falsePositiveCount();
+
+        // The same absent lookups in prefetched batches.
+        const std::size_t batch = 1000;
+        std::vector<std::uint64_t> keys(batch);
+        std::unique_ptr<bool[]> answers(new bool[batch]);
+        start = nowNanos();
+        for (std::uint64_t i = 0; i < callers; i += batch) {
+            for (std::size_t j = 0; j < batch; ++j) keys[j] = firstNumber + callers + i + j;
+            filter.isRepeat(keys.data(), batch, answers.get(), 0);
+            repeats += answers[0];
+        }
+        double batchedAbsentNs = perCaller(start);
+
+        start = nowNanos();
+        for (std::uint64_t i = 0; i < callers; ++i) repeats += filter.isRepeat(firstNumber + i, 0);
+        double presentNs = perCaller(start);
+
+        start = nowNanos();
+        for (std::uint64_t i = 0; i < callers; ++i) repeats += filter.containsExact(firstNumber + callers + i);
+        double exactAbsentNs = perCaller(start);
+
+        start = nowNanos();
+        for (std::uint64_t i = 0; i < callers; ++i) filter.forget(firstNumber + i);
+        double forgetNs = perCaller(start);
+        doNotOptimize(repeats);
+
+        std::cout << "{\"benchmark\":\"repeat_caller_filter\",\"callers\":" << callers
+            << ",\"filter_mb\":" << filter.filterBytes() / 1048576.0
+            << ",\"record_ns\":" << recordNs << ",\"absent_lookup_ns\":" << absentNs
+            << ",\"batched_absent_lookup_ns\":" << batchedAbsentNs << ",\"present_lookup_ns\":" << presentNs
+            << ",\"exact_only_absent_lookup_ns\":" << exactAbsentNs << ",\"forget_ns\":" << forgetNs
+            << ",\"false_positive_rate\":" << static_cast<double>(falsePositives) / callers << "}\n";
+    }
+}
+
+// 100k tenants with small mixed capacities: create, destroy/create churn and
+// enqueue/dequeue cost, and memory per tenant against one CircularQueue each.
+void benchmarkTenantQueues() {
+    const int tenantCount = 100000;
+    FastRandom random(44);
+    std::vector<int> capacities(tenantCount);
+    for (int& capacity : capacities) capacity = 8 << (random.next() % 4); // 8 to 64 calls
+
+    TenantQueueManager manager;
+    std::vector<int> tenants(tenantCount);
+    std::size_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+    std::int64_t start = nowNanos();
+    for (int i = 0; i < tenantCount; ++i) tenants[i] = manager.createTenant(capacities[i]);
+    double createNs = static_cast<double>(nowNanos() - start) / tenantCount;
+    std::size_t managerAllocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+    std::size_t slotBytes = 0;
+    for (int tenant : tenants) slotBytes += manager.capacityOf(tenant) * sizeof(Call);
+
+    const int churn = 1000000;
+    start = nowNanos();
+    for (int i = 0; i < churn; ++i) {
+        int victim = static_cast<int>(random.next() % tenantCount);
+        manager.destroyTenant(tenants[victim]);
+        tenants[victim] = manager.createTenant(capacities[victim]);
+    }
+    double churnNs = static_cast<double>(nowNanos() - start) / churn;
+
+    const long long operations = 10000000;
+    Call call = { 1, CallType::NORMAL, 5, false };
+    start = nowNanos();
+    for (long long i = 0; i < operations; ++i) {
+        int tenant = tenants[static_cast<int>(random.next() % tenantCount)];
+        if (!manager.enqueue(tenant, call)) manager.dequeue(tenant, call);
+    }
+    double operationNs = static_cast<double>(nowNanos() - start) / operations;
+
+    std::cout << "{\"benchmark\":\"tenant_manager\",\"tenants\":" << tenantCount
+        << ",\"create_ns\":" << createNs << ",\"destroy_create_ns\":" << churnNs << ",\"op_ns\":" << operationNs
+        << ",\"heap_allocations\":" << AllocationRate{ managerAllocations, 1.0 } << ",\"slabs\":" << manager.slabCount()
+        << ",\"slot_bytes\":" << slotBytes << ",\"reserved_bytes\":" << manager.reservedBytes()
+        << ",\"overhead_bytes_per_tenant\":" << static_cast<double>(manager.reservedBytes() - slotBytes) / tenantCount << "}\n";
+
+    // The same tenants as one CircularQueue each.
+    allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+    start = nowNanos();
+    std::vector<CircularQueue> queues;
+    queues.reserve(tenantCount);
+    for (int capacity : capacities) queues.emplace_back(capacity);
+    double queueCreateNs = static_cast<double>(nowNanos() - start) / tenantCount;
+    std::size_t queueAllocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+    for (CircularQueue& queue : queues) queue.setVerbose(false);
+    start = nowNanos();
+    for (long long i = 0; i < operations; ++i) {
+        CircularQueue& queue = queues[random.next() % tenantCount];
+        if (!queue.enqueue(call)) queue.dequeue(call);
+    }
+    double queueOperationNs = static_cast<double>(nowNanos() - start) / operations;
+    std::size_t queueBytes = 0;
+    for (int capacity : capacities) {
+        queueBytes += sizeof(CircularQueue) + capacity * sizeof(Call) + 16; // plus malloc's chunk header
+    }
+    std::cout << "{\"benchmark\":\"circular_queue_per_tenant\",\"tenants\":" << tenantCount
+        << ",\"create_ns\":" << queueCreateNs << ",\"op_ns\":" << queueOperationNs
+        << ",\"heap_allocations\":" << AllocationRate{ queueAllocations, 1.0 } << ",\"bytes\":" << queueBytes
+        << ",\"overhead_bytes_per_tenant\":" << sizeof(CircularQueue) + 16 << "}\n";
+}
+
+// Jain's fairness index of the service each queue received per unit of
+// weight: 1 when perfectly proportional, 1/n when one queue got everything.
+inline double jainFairness(const std::vector<double>& normalizedService) {
+    double sum = 0, squares = 0;
+    for (double service : normalizedService) {
+        sum += service;
+        squares += service * service;
+    }
+    return squares > 0 ? sum * sum / (normalizedService.size() * squares) : 1;
+}
+
+// DRR across 10k queues: dispatch cost with everything or only a few queues
+// backlogged (idle queues must not matter), and the fairness of the service
+// backlogged queues receive for weights 1 to 4.
+void benchmarkDeficitRoundRobin() {
+    const int queueCount = 10000;
+    const int perQueue = 64;
+    for (int backlogged : { queueCount, 1000, 10 }) {
+        std::vector<CircularQueue> queues;
+        queues.reserve(queueCount);
+        DeficitRoundRobin scheduler(60);
+        FastRandom random(45);
+        std::vector<double> weights(queueCount);
+        for (int i = 0; i < queueCount; ++i) {
+            queues.emplace_back(perQueue);
+            queues.back().setVerbose(false);
+            weights[i] = 1 + static_cast<double>(i % 4);
+            scheduler.addQueue(queues.back(), weights[i]);
+        }
+        LoadProfile profile;
+        profile.durations = DurationModel::UNIFORM;
+        profile.meanDuration = 30; // 1 to 59 minutes, under the quantum
+        CallLoadGenerator generator(profile, 45);
+        std::int64_t arrival;
+        for (int i = 0; i < backlogged; ++i) {
+            for (int j = 0; j < perQueue; ++j) scheduler.enqueue(i * (queueCount / backlogged), generator.next(arrival));
+        }
+
+        // Each served call is replaced by one for the same queue, keeping
+        // the backlog steady.
+        const long long dispatches = 2000000;
+        std::vector<double> service(queueCount, 0);
+        Call call;
+        int from = 0;
+        std::int64_t start = nowNanos();
+        for (long long i = 0; i < dispatches; ++i) {
+            scheduler.dequeue(call, &from);
+            service[from] += std::max(call.duration, 1);
+            scheduler.enqueue(from, generator.next(arrival));
+        }
+        double nsPerDispatch = static_cast<double>(nowNanos() - start) / dispatches;
+
+        std::vector<double> normalized;
+        for (int i = 0; i < backlogged; ++i) {
+            int index = i * (queueCount / backlogged);
+            normalized.push_back(service[index] / weights[index]);
+        }
+        auto [least, most] = std::minmax_element(normalized.begin(), normalized.end());
+        std::cout << "{\"benchmark\":\"drr_dispatch\",\"queues\":" << queueCount << ",\"backlogged\":" << backlogged
+            << ",\"dispatches\":" << dispatches << ",\"ns_per_dispatch_and_enqueue\":" << nsPerDispatch
+            << ",\"jain_fairness\":" << jainFairness(normalized)
+            << ",\"min_to_max_service_per_weight\":" << *least / *most << "}\n";
+    }
+}
+
+// Average latency of a dependent random walk through `region`, which defeats
+// prefetching so every step is a memory access.
+inline double pointerChaseNs(void* region, std::size_t bytes) {
+    std::size_t count = bytes / sizeof(std::size_t);
+    std::size_t* next = static_cast<std::size_t*>(region);
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; ++i) order[i] = i;
+    FastRandom random(46);
+    for (std::size_t i = count - 1; i > 0; --i) std::swap(order[i], order[random.next() % (i + 1)]);
+    for (std::size_t i = 0; i < count; ++i) next[order[i]] = order[(i + 1) % count];
+    const long long steps = 5000000;
+    std::size_t position = order[0];
+    std::int64_t start = nowNanos();
+    for (long long i = 0; i < steps; ++i) position = next[position];
+    doNotOptimize(position);
+    return static_cast<double>(nowNanos() - start) / steps;
+}
+
+// NUMA placement and dispatch. On a multi-node host, compares memory latency
+// from node 0 to rings bound to node 0 and to node 1. On any host, runs
+// producers and consumers on a fake 2-node topology, with node 0 receiving
+// three times the calls, and reports how many dequeues stayed local and how
+// many were stolen.
+void benchmarkNumaQueue() {
+    NumaTopology real = NumaTopology::detect();
+    NumaShardedQueue probe(real, 1024);
+    std::cout << "{\"benchmark\":\"numa_topology\",\"nodes\":" << real.nodeCount()
+        << ",\"mbind\":" << (probe.isNodeBound() ? "true" : "false") << "}\n";
+    if (real.nodeCount() >= 2) {
+        const std::size_t bytes = 256 << 20;
+        real.pinToNode(0);
+        NodeLocalMemory local(bytes, 0), remote(bytes, 1);
+        std::cout << "{\"benchmark\":\"numa_latency\",\"local_ns\":" << pointerChaseNs(local.data(), bytes)
+            << ",\"remote_ns\":" << pointerChaseNs(remote.data(), bytes) << "}\n";
+    }
+
+    NumaTopology topology = NumaTopology::fake(2);
+    const long long callsPerNode[2] = { 3000000, 1000000 };
+    NumaShardedQueue queue(topology, 1 << 16);
+    std::atomic<long long> remaining{ callsPerNode[0] + callsPerNode[1] };
+    std::vector<std::thread> threads;
+    std::int64_t start = nowNanos();
+    for (int node = 0; node < 2; ++node) {
+        threads.emplace_back([&, node] {
+            Call call = { 0, CallType::NORMAL, 5, false };
+            for (long long i = 0; i < callsPerNode[node]; ++i) {
+                call.callId = static_cast<int>(i);
+                while (!queue.enqueue(call, node)) std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&, node] {
+            Call call;
+            while (remaining.load(std::memory_order_relaxed) > 0) {
+                if (queue.dequeue(call, node)) remaining.fetch_sub(1, std::memory_order_relaxed);
+                else std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = (nowNanos() - start) / 1e9;
+    for (int node = 0; node < 2; ++node) {
+        std::cout << "{\"benchmark\":\"numa_dispatch\",\"fake_nodes\":2,\"node\":" << node
+            << ",\"enqueued\":" << callsPerNode[node] << ",\"local_dequeues\":" << queue.localDequeues(node)
+            << ",\"stolen_by_other_node\":" << queue.stolenDequeues(node) << "}\n";
+    }
+    std::cout << "{\"benchmark\":\"numa_dispatch_throughput\",\"calls_per_sec\":"
+        << (callsPerNode[0] + callsPerNode[1]) / seconds << "}\n";
+}
+
+// Rings of 4M calls backed by small pages, transparent huge pages and
+// explicit huge pages (each reported as actually obtained): random-position
+// reads, which miss the TLB on small pages, and a full sequential dequeue.
+void benchmarkHugePageRing() {
+    const int capacity = 1 << 22;
+    for (RingBacking requested : { RingBacking::SMALL_PAGES, RingBacking::TRANSPARENT_HUGE_PAGES, RingBacking::EXPLICIT_HUGE_PAGES }) {
+        CircularQueue cq(capacity, requested);
+        cq.setVerbose(false);
+        Call call = { 0, CallType::NORMAL, 5, false };
+        for (int i = 0; i < capacity; ++i) {
+            call.callId = i;
+            cq.enqueue(call);
+        }
+
+        FastRandom random(47);
+        const long long reads = 10000000;
+        long long checksum = 0;
+        std::int64_t start = nowNanos();
+        for (long long i = 0; i < reads; ++i) checksum += cq.at(static_cast<int>(random.next() & (capacity - 1))).callId;
+        double randomNs = static_cast<double>(nowNanos() - start) / reads;
+
+        start = nowNanos();
+        while (cq.dequeue(call)) checksum += call.callId;
+        double dequeueNs = static_cast<double>(nowNanos() - start) / capacity;
+        doNotOptimize(checksum);
+
+        std::cout << "{\"benchmark\":\"huge_page_ring\",\"capacity\":" << capacity
+            << ",\"requested\":\"" << ringBackingName(requested) << "\",\"obtained\":\"" << ringBackingName(cq.ringBacking())
+            << "\",\"random_read_ns\":" << randomNs << ",\"sequential_dequeue_ns\":" << dequeueNs << "}\n";
+    }
+}
+
+// Compares reporting over the live ring through its iterators with copying
+// the calls out first, for rings that wrap partway through.
+void benchmarkRingIteration() {
+    for (int capacity : { 1 << 10, 1 << 16, 1 << 20 }) {
+        CircularQueue cq(capacity);
+        cq.setVerbose(false);
+        Call call = { 0, CallType::NORMAL, 0, false };
+        for (int i = 0; i < capacity; ++i) {
+            call.callId = i;
+            call.type = (i % 8 == 0) ? CallType::EMERGENCY : CallType::NORMAL;
+            call.duration = i % 30;
+            cq.enqueue(call);
+        }
+        for (int i = 0; i < capacity / 2; ++i) {
+            cq.dequeue(call);
+            cq.enqueue(call); // front ends up mid-ring
+        }
+
+        const int rounds = std::max(1, (1 << 24) / capacity);
+        auto isEmergency = [](const Call& c) { return c.type == CallType::EMERGENCY; };
+        auto addDuration = [](long long total, const Call& c) { return total + c.duration; };
+        long long checksum = 0;
+
+        std::int64_t start = nowNanos();
+        for (int r = 0; r < rounds; ++r) {
+            checksum += std::count_if(cq.begin(), cq.end(), isEmergency);
+            checksum += std::accumulate(cq.begin(), cq.end(), 0LL, addDuration);
+        }
+        double iteratorNs = static_cast<double>(nowNanos() - start) / (static_cast<double>(rounds) * capacity);
+
+        start = nowNanos();
+        for (int r = 0; r < rounds; ++r) {
+            checksum += std::ranges::count_if(cq.calls(), isEmergency);
+            for (const Call& c : cq.calls() | std::views::filter(isEmergency)) checksum += c.duration;
+        }
+        double viewNs = static_cast<double>(nowNanos() - start) / (static_cast<double>(rounds) * capacity);
+
+        start = nowNanos();
+        for (int r = 0; r < rounds; ++r) {
+            std::vector<Call> copy;
+            copy.reserve(cq.size());
+            for (int position = 0; position < cq.size(); ++position) copy.push_back(cq.at(position));
+            checksum += std::count_if(copy.begin(), copy.end(), isEmergency);
+            checksum += std::accumulate(copy.begin(), copy.end(), 0LL, addDuration);
+        }
+        double copyNs = static_cast<double>(nowNanos() - start) / (static_cast<double>(rounds) * capacity);
+        doNotOptimize(checksum);
+
+        std::cout << "{\"benchmark\":\"ring_iteration\",\"calls\":" << capacity
+            << ",\"iterator_ns_per_call\":" << iteratorNs << ",\"ranges_view_ns_per_call\":" << viewNs
+            << ",\"copy_out_ns_per_call\":" << copyNs << "}\n";
+    }
+}
+
+// Times the parallel prioritize against the serial one on wrapped rings of
+// millions of calls, and checks that both leave the calls in the same order.
+void benchmarkParallelPrioritize() {
+    int hardwareThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int size : { 1 << 20, 1 << 22 }) {
+        for (double ratio : { 0.1, 0.5 }) {
+            CircularQueue serial(size + 1);
+            CircularQueue parallel(size + 1);
+            serial.setVerbose(false);
+            parallel.setVerbose(false);
+
+            OperationSample serialSample = repeatRounds([&](OperationSample& sample) {
+                resetQueuePosition(serial, true);
+                fillQueue(serial, ratio);
+                timeOperations(sample, [&] {
+                    serial.prioritizeEmergencyCalls();
+                    return 1LL;
+                });
+            }, 200000000);
+            double serialMs = static_cast<double>(serialSample.nanos) / serialSample.ops / 1e6;
+
+            std::vector<int> threadCounts = { 1, 2, 4, 8 };
+            if (std::ranges::find(threadCounts, hardwareThreads) == threadCounts.end()) threadCounts.push_back(hardwareThreads);
+            for (int threads : threadCounts) {
+                OperationSample sample = repeatRounds([&](OperationSample& round) {
+                    resetQueuePosition(parallel, true);
+                    fillQueue(parallel, ratio);
+                    timeOperations(round, [&] {
+                        parallel.prioritizeEmergencyCalls(threads);
+                        return 1LL;
+                    });
+                }, 200000000);
+                double parallelMs = static_cast<double>(sample.nanos) / sample.ops / 1e6;
+                bool matches = std::ranges::equal(serial.calls(), parallel.calls(), {}, &Call::callId, &Call::callId);
+
+                std::cout << "{\"benchmark\":\"parallel_prioritize\",\"size\":" << size << ",\"emergency_ratio\":" << ratio
+                    << ",\"threads\":" << threads << ",\"hardware_threads\":" << hardwareThreads
+                    << ",\"serial_ms\":" << serialMs << ",\"parallel_ms\":" << parallelMs
+                    << ",\"speedup\":" << serialMs / parallelMs << ",\"matches_serial\":" << (matches ? "true" : "false") << "}\n";
+            }
+        }
+    }
+}
+
+// Compares keeping caller metadata in a side table keyed by callId with
+// interning it in the queue's CallerArena, on a queue held half full.
+void benchmarkCallerMetadata() {
+    const int capacity = 4096;
+    const long long calls = 2000000;
+    const char* languages[] = { "en", "es", "fr", "zh", "vi", "ar" };
+    std::vector<std::string> numbers(200000), accounts(50000);
+    for (std::size_t i = 0; i < numbers.size(); ++i) numbers[i] = "+1555" + std::to_string(1000000 + i);
+    for (std::size_t i = 0; i < accounts.size(); ++i) accounts[i] = "ACC-" + std::to_string(100000000000 + i);
+
+    struct CallerRecord {
+        std::string number, language, account;
+    };
+    auto metadataOf = [&](long long i) {
+        std::uint64_t mixed = mixKey(static_cast<std::uint64_t>(i));
+        return std::tuple<const std::string&, const char*, const std::string&>(
+            numbers[mixed % numbers.size()], languages[(mixed >> 20) % 6], accounts[(mixed >> 40) % accounts.size()]);
+    };
+
+    for (bool arena : { false, true }) {
+        CircularQueue cq(capacity);
+        cq.setVerbose(false);
+        std::unordered_map<int, CallerRecord> sideTable;
+        Call call = { 0, CallType::NORMAL, 5, false };
+        long long next = 0;
+        std::size_t checksum = 0;
+        auto enqueueNext = [&] {
+            call.callId = static_cast<int>(next);
+            auto [number, language, account] = metadataOf(next++);
+            if (arena) {
+                cq.enqueue(call, number, language, account);
+            }
+            else {
+                cq.enqueue(call);
+                sideTable.emplace(call.callId, CallerRecord{ number, language, account });
+            }
+        };
+        for (int i = 0; i < capacity / 2; ++i) enqueueNext();
+
+        // Alternate batches of arrivals and answers, so the queue swings
+        // between half full and full, and time each side separately.
+        std::size_t enqueueAllocations = 0, dispatchAllocations = 0;
+        std::int64_t enqueueNanos = 0, dispatchNanos = 0;
+        for (long long done = 0; done < calls; done += capacity / 2) {
+            std::size_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+            std::int64_t start = nowNanos();
+            for (int i = 0; i < capacity / 2; ++i) enqueueNext();
+            enqueueNanos += nowNanos() - start;
+            enqueueAllocations += heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+            allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+            start = nowNanos();
+            for (int i = 0; i < capacity / 2; ++i) {
+                Call answered{};
+                cq.dequeue(answered);
+                if (arena) {
+                    checksum += cq.callerNumber(answered).size() + cq.callerLanguage(answered).size()
+                        + cq.callerAccount(answered).size();
+                }
+                else {
+                    auto found = sideTable.find(answered.callId);
+                    checksum += found->second.number.size() + found->second.language.size() + found->second.account.size();
+                    sideTable.erase(found);
+                }
+            }
+            dispatchNanos += nowNanos() - start;
+            dispatchAllocations += heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+        }
+        doNotOptimize(checksum);
+
+        std::cout << "{\"benchmark\":\"caller_metadata\",\"storage\":\"" << (arena ? "interned_arena" : "side_table")
+            << "\",\"calls\":" << calls << ",\"enqueue_ns\":" << static_cast<double>(enqueueNanos) / calls
+            << ",\"dispatch_ns\":" << static_cast<double>(dispatchNanos) / calls
+            << ",\"enqueue_allocs\":" << AllocationRate{ enqueueAllocations, static_cast<double>(calls) }
+            << ",\"dispatch_allocs\":" << AllocationRate{ dispatchAllocations, static_cast<double>(calls) }
+            << ",\"call_bytes\":" << sizeof(Call);
+        if (arena) {
+            std::cout << ",\"interned_strings\":" << cq.callerArena().stringCount()
+                << ",\"arena_reserved_bytes\":" << cq.callerArena().reservedBytes();
+        }
+        std::cout << "}\n";
+    }
+}
+
+// Runs the benchmark or tool named on the command line.
+int runCommand(const std::vector<std::string>& args) {
+    const std::string& command = args[0];
+    if (command == "replay") {
+        return replayCommand(args);
+    }
+    if (command == "generate-trace") {
+        return generateTraceCommand(args);
+    }
+    if (command == "bench-wal") {
+        benchmarkWriteAheadLog();
+        return 0;
+    }
+    if (command == "bench-persistent-ring") {
+        benchmarkPersistentRing();
+        return 0;
+    }
+    if (command == "bench-shared-queue") {
+        benchmarkSharedQueue();
+        return 0;
+    }
+    if (command == "bench-replication") {
+        benchmarkReplication();
+        return 0;
+    }
+    if (command == "bench") {
+        benchmarkCircularQueue();
+        return 0;
+    }
+    if (command == "bench-loadgen") {
+        benchmarkLoadGenerator();
+        return 0;
+    }
+    if (command == "bench-wait-histogram") {
+        benchmarkWaitHistograms();
+        return 0;
+    }
+    if (command == "bench-metrics") {
+        benchmarkQueueMetrics();
+        return 0;
+    }
+    if (command == "bench-tracing") {
+        benchmarkLifecycleTracing();
+        return 0;
+    }
+    if (command == "sim-aging") {
+        simulateAgingTradeoff();
+        return 0;
+    }
+    if (command == "bench-edf") {
+        benchmarkDeadlineScheduler();
+        return 0;
+    }
+    if (command == "sim-deadlines") {
+        simulateDeadlines();
+        return 0;
+    }
+    if (command == "sim-shortest-first") {
+        simulateShortestFirst();
+        return 0;
+    }
+    if (command == "bench-wait-estimate") {
+        benchmarkWaitEstimator();
+        return 0;
+    }
+    if (command == "bench-positions") {
+        benchmarkPositionIndex();
+        return 0;
+    }
+    if (command == "bench-async") {
+        benchmarkAsyncQueue();
+        return 0;
+    }
+    if (command == "sim-overload") {
+        simulateOverload();
+        return 0;
+    }
+    if (command == "bench-dedup") {
+        benchmarkRepeatCallerFilter();
+        return 0;
+    }
+    if (command == "bench-tenants") {
+        benchmarkTenantQueues();
+        return 0;
+    }
+    if (command == "bench-drr") {
+        benchmarkDeficitRoundRobin();
+        return 0;
+    }
+    if (command == "bench-numa") {
+        benchmarkNumaQueue();
+        return 0;
+    }
+    if (command == "bench-huge-pages") {
+        benchmarkHugePageRing();
+        return 0;
+    }
+    if (command == "bench-iterate") {
+        benchmarkRingIteration();
+        return 0;
+    }
+    if (command == "bench-parallel-prioritize") {
+        benchmarkParallelPrioritize();
+        return 0;
+    }
+    if (command == "bench-caller-metadata") {
+        benchmarkCallerMetadata();
+        return 0;
+    }
+    std::cerr << "Unknown command: " << command << "\n"
+        << "Usage: TelephoneQueue [replay|generate-trace|bench-wal|bench-persistent-ring|bench-shared-queue|bench-replication|bench|bench-loadgen|bench-wait-histogram|bench-metrics|bench-tracing|sim-aging|bench-edf|sim-deadlines|sim-shortest-first|bench-wait-estimate|bench-positions|bench-async|sim-overload|bench-dedup|bench-tenants|bench-drr|bench-numa|bench-huge-pages|bench-iterate|bench-parallel-prioritize|bench-caller-metadata]\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) return runCommand(std::vector<std::string>(argv + 1, argv + argc));
+
+    {
+        CircularQueue cq(5);  std::cout << "\n\n";
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+        Call call5 = { 5, CallType::NORMAL, 20, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.dequeue();
+        cq.dequeue();
+
+        std::cout << "Queue after two dequeues:\n";
+        cq.display();  std::cout << "\n\n";
+    }
+
+
+
+    // Happy Path Test Case 2
+
+    {
+        CircularQueue cq(4);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.dequeue();
+        cq.dequeue();
+
+        std::cout << "Queue after two dequeues:\n";
+        cq.display();  std::cout << "\n\n";
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Queue after prioritizing emergency calls:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Dequeued Call ID: 2
+    // Dequeued Call ID: 4
+    // Queue after two dequeues:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+
+    // Edge Case Test Case 2
+
+    {
+        CircularQueue cq(5);  std::cout << "\n\n";
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+        Call call5 = { 5, CallType::NORMAL, 20, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        // Attempt to enqueue another call to test overflow
+        Call call6 = { 6, CallType::NORMAL, 12, false };
+        cq.enqueue(call6); // This should trigger Queue Overflow
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Queue after prioritizing emergency calls:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Queue Overflow! Cannot enqueue call.
+
+    // Happy Path Test Case 2
+
+    {
+        CircularQueue cq(4);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.dequeue();
+        cq.dequeue();
+
+        std::cout << "Queue after two dequeues:\n";
+        cq.display();  std::cout << "\n\n";
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Queue after prioritizing emergency calls:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Dequeued Call ID: 2
+    // Dequeued Call ID: 4
+    // Queue after two dequeues:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+
+    // Edge Case Test Case 2
+    {
+        CircularQueue cq(5);  std::cout << "\n\n";
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+        Call call5 = { 5, CallType::NORMAL, 20, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        // Attempt to enqueue another call to test overflow
+        Call call6 = { 6, CallType::NORMAL, 12, false };
+        cq.enqueue(call6); // This should trigger Queue Overflow
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Queue after prioritizing emergency calls:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Queue Overflow! Cannot enqueue call.
+
+    // Happy Path Test Case 2
+    {
+        CircularQueue cq(4);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.dequeue();
+        cq.dequeue();
+
+        std::cout << "Queue after two dequeues:\n";
+        cq.display();  std::cout << "\n\n";
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Queue after prioritizing emergency calls:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Dequeued Call ID: 2
+    // Dequeued Call ID: 4
+    // Queue after two dequeues:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+
+    // Edge Case Test Case 2
+    {
+        CircularQueue cq(5);  std::cout << "\n\n";
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+        Call call5 = { 5, CallType::NORMAL, 20, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        // Attempt to enqueue another call to test overflow
+        Call call6 = { 6, CallType::NORMAL, 12, false };
+        cq.enqueue(call6); // This should trigger Queue Overflow
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Queue after prioritizing emergency calls:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Queue Overflow! Cannot enqueue call.
+
+    // Happy Path Test Case 2
+    {
+        CircularQueue cq(4);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.enqueue(call4);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.dequeue();
+        cq.dequeue();
+
+        std::cout << "Queue after two dequeues:\n";
+        cq.display();  std::cout << "\n\n";
+
+
+    }
+    // Expected Output:
+    // Initial Queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Queue after prioritizing emergency calls:
     // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
     // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
     // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
@@ -2805,9 +8897,505 @@ int main() {
     // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
     // Queue Overflow! Cannot enqueue call.
 
-    // Happy Path Test Case 2
+    // Write-Ahead Log Recovery Test Case
+    {
+        const std::string logPath = "telephone_queue.wal";
+        std::remove(logPath.c_str());
+        {
+            CircularQueue cq(4);
+            WriteAheadLog wal(logPath, 4, 1);
+            cq.attachJournal(&wal);
+
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::EMERGENCY, 5, true };
+            Call call3 = { 3, CallType::NORMAL, 15, false };
+            Call call4 = { 4, CallType::EMERGENCY, 8, true };
+            Call call5 = { 5, CallType::NORMAL, 20, false };
+
+            cq.enqueue(call1);
+            cq.enqueue(call2);
+            cq.enqueue(call3);
+            cq.dequeue();
+            cq.enqueue(call4);
+            cq.enqueue(call5);
+
+            std::cout << "Queue before crash:\n";
+            cq.display();  std::cout << "\n\n";
+        }
+
+        // Simulate a record torn by the crash
+        FILE* log = std::fopen(logPath.c_str(), "ab");
+        std::fputs("torn", log);
+        std::fclose(log);
+
+        CircularQueue recovered(4);
+        std::cout << "Records recovered: " << WriteAheadLog::recover(logPath, recovered) << "\n";
+        std::cout << "Queue after recovery:\n";
+        recovered.display();  std::cout << "\n\n";
+
+        {
+            WriteAheadLog wal(logPath, 4, 1);
+            recovered.attachJournal(&wal);
+            wal.checkpoint(recovered);
+            recovered.dequeue();
+            recovered.attachJournal(nullptr);
+        }
+
+        CircularQueue afterCheckpoint(4);
+        std::cout << "Records recovered after checkpoint: " << WriteAheadLog::recover(logPath, afterCheckpoint) << "\n";
+        std::cout << "Queue after checkpoint and one more dequeue:\n";
+        afterCheckpoint.display();  std::cout << "\n\n";
+        std::remove(logPath.c_str());
+    }
+    // Expected Output:
+    // Enqueued Call ID: 1
+    // Enqueued Call ID: 2
+    // Enqueued Call ID: 3
+    // Dequeued Call ID: 1
+    // Enqueued Call ID: 4
+    // Enqueued Call ID: 5
+    // Queue before crash:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Records recovered: 6
+    // Queue after recovery:
+    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Dequeued Call ID: 2
+    // Records recovered after checkpoint: 2
+    // Queue after checkpoint and one more dequeue:
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+
+    // Persistent Ring Restart Test Case
+    {
+        const std::string ringPath = "telephone_queue.ring";
+        std::remove(ringPath.c_str());
+        {
+            PersistentCircularQueue ring(ringPath, 4);
+
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::EMERGENCY, 5, true };
+            Call call3 = { 3, CallType::NORMAL, 15, false };
+            Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+            ring.enqueue(call1);
+            ring.enqueue(call2);
+            ring.enqueue(call3);
+            ring.prioritizeEmergencyCalls();
+            ring.dequeue();
+            ring.enqueue(call4);
+
+            std::cout << "Persistent queue before restart:\n";
+            ring.display();  std::cout << "\n\n";
+        }
+
+        {
+            PersistentCircularQueue resized(ringPath, 8); // refused, the ring is kept
+            std::cout << "Opened with a different capacity: " << (resized.isOpen() ? "Yes" : "No") << "\n";
+        }
+
+        PersistentCircularQueue ring(ringPath, 4);
+        std::cout << "Reattached to existing ring: " << (ring.wasRecovered() ? "Yes" : "No") << "\n";
+        std::cout << "Persistent queue after restart:\n";
+        ring.display();  std::cout << "\n\n";
+
+        Call call5 = { 5, CallType::NORMAL, 20, false };
+        Call call6 = { 6, CallType::NORMAL, 12, false };
+        ring.enqueue(call5);
+        ring.enqueue(call6); // This should trigger Queue Overflow
+        std::remove(ringPath.c_str());
+    }
+    // Expected Output:
+    // Enqueued Call ID: 1
+    // Enqueued Call ID: 2
+    // Enqueued Call ID: 3
+    // Dequeued Call ID: 2
+    // Enqueued Call ID: 4
+    // Persistent queue before restart:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Opened with a different capacity: No
+    // Reattached to existing ring: Yes
+    // Persistent queue after restart:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Enqueued Call ID: 5
+    // Queue Overflow! Cannot enqueue call.
+
+    // Shared-Memory Queue Across Processes Test Case
+    {
+        SharedCallQueue cq("/telephone_queue_test", 4);
+
+        // The child inherits the mapping and the wakeup eventfd
+        pid_t child = fork();
+        if (child == 0) {
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::EMERGENCY, 5, true };
+            Call call3 = { 3, CallType::NORMAL, 15, false };
+            cq.enqueue(call1);
+            cq.enqueue(call2);
+            cq.enqueue(call3);
+            _exit(0);
+        }
+
+        Call call;
+        for (int i = 0; i < 3; ++i) {
+            cq.waitDequeue(call);
+            std::cout << "Received Call ID: " << call.callId << " from another process\n";
+        }
+        waitpid(child, nullptr, 0);
+        std::cout << "Queue empty after transfer: " << (cq.isEmpty() ? "Yes" : "No") << "\n\n";
+        cq.unlink();
+    }
+    // Expected Output:
+    // Received Call ID: 1 from another process
+    // Received Call ID: 2 from another process
+    // Received Call ID: 3 from another process
+    // Queue empty after transfer: Yes
+
+    // Log-Shipping Replication and Promotion Test Case
+    {
+        int sv[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+        std::cout << std::flush;
+
+        pid_t standby = fork();
+        if (standby == 0) {
+            close(sv[0]);
+            CircularQueue replica(4);
+            replica.setVerbose(false);
+            ReplicationFollower follower(sv[1], replica);
+            follower.run();
+            std::cout << "Standby promoted at operation " << follower.promote() << "\n";
+            std::cout << "Promoted standby queue:\n";
+            replica.display();  std::cout << "\n\n";
+            std::cout << std::flush;
+            _exit(0);
+        }
+        close(sv[1]);
+
+        CircularQueue cq(4);
+        ReplicationLeader leader(sv[0]);
+        cq.attachJournal(&leader);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+        Call call5 = { 5, CallType::NORMAL, 20, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.prioritizeEmergencyCalls();
+        cq.dequeue();
+        cq.cancel(3);
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+        Call redial = { 1, CallType::NORMAL, 30, false }; // same id as call1
+        cq.enqueue(redial);
+        cq.removeNewest(redial);
+
+        std::cout << "Leader queue:\n";
+        cq.display();  std::cout << "\n\n";
+        std::cout << std::flush;
+
+        bool handedOff = leader.handoff();
+        waitpid(standby, nullptr, 0);
+        close(sv[0]);
+        std::cout << "Handoff acknowledged: " << (handedOff ? "Yes" : "No") << "\n\n";
+    }
+    // Expected Output:
+    // Enqueued Call ID: 1
+    // Enqueued Call ID: 2
+    // Enqueued Call ID: 3
+    // Dequeued Call ID: 2
+    // Cancelled Call ID: 3
+    // Enqueued Call ID: 4
+    // Enqueued Call ID: 5
+    // Enqueued Call ID: 1
+    // Cancelled Call ID: 1
+    // Leader queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Standby promoted at operation 10
+    // Promoted standby queue:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Handoff acknowledged: Yes
+
+    // Log-Shipping Replication Test Case: Malformed Frames
+    {
+        auto feed = [](const ReplicationFrame& frame, const std::vector<char>& payload) {
+            int sv[2];
+            socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+            sendAll(sv[0], &frame, sizeof(frame));
+            sendAll(sv[0], payload.data(), payload.size());
+            close(sv[0]);
+            CircularQueue replica(4);
+            replica.setVerbose(false);
+            ReplicationFollower follower(sv[1], replica);
+            follower.applyNextBatch();
+            std::cout << (follower.hasDiverged() ? "diverged" : "applied") << ", Calls applied: " << replica.size() << "\n";
+            follower.promote();
+        };
+
+        Call call = { 1, CallType::NORMAL, 10, false };
+        std::vector<char> oneEnqueue(1 + sizeof(Call));
+        oneEnqueue[0] = static_cast<char>(QueueOp::ENQUEUE);
+        std::memcpy(oneEnqueue.data() + 1, &call, sizeof(Call));
+
+        ReplicationFrame frame{};
+        frame.firstSequence = 1;
+        frame.length = static_cast<std::uint32_t>(oneEnqueue.size());
+        frame.count = 2; // claims a second record the payload does not hold
+        std::cout << "Frame short of its record count: ";
+        feed(frame, oneEnqueue);
+
+        std::vector<char> truncated(oneEnqueue.begin(), oneEnqueue.begin() + 9);
+        frame.length = static_cast<std::uint32_t>(truncated.size());
+        frame.count = 1;
+        std::cout << "Frame with a truncated Call: ";
+        feed(frame, truncated);
+
+        frame.length = kMaxReplicationFrameBytes + 1;
+        std::cout << "Oversized frame: ";
+        feed(frame, {});
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Frame short of its record count: diverged, Calls applied: 0
+    // Frame with a truncated Call: diverged, Calls applied: 0
+    // Oversized frame: diverged, Calls applied: 0
+
+    // Edge Case Test Case: Prioritizing a Queue That Wraps Around
+    {
+        CircularQueue cq(4);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::NORMAL, 15, false };
+        Call call3 = { 3, CallType::NORMAL, 20, false };
+        Call call4 = { 4, CallType::EMERGENCY, 5, true };
+        Call call5 = { 5, CallType::NORMAL, 12, false };
+        Call call6 = { 6, CallType::EMERGENCY, 8, true };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.dequeue();
+        cq.dequeue();
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+        cq.enqueue(call6);
+
+        std::cout << "Initial Queue:\n";
+        cq.display();  std::cout << "\n\n";
+
+        cq.prioritizeEmergencyCalls();
+
+        std::cout << "Queue after prioritizing emergency calls:\n";
+        cq.display();  std::cout << "\n\n";
+    }
+    // Expected Output:
+    // Enqueued Call ID: 1
+    // Enqueued Call ID: 2
+    // Enqueued Call ID: 3
+    // Dequeued Call ID: 1
+    // Dequeued Call ID: 2
+    // Enqueued Call ID: 4
+    // Enqueued Call ID: 5
+    // Enqueued Call ID: 6
+    // Initial Queue:
+    // Call ID: 3, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 5, Type: NORMAL, Duration: 12, Callback Requested: No
+    // Call ID: 6, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Queue after prioritizing emergency calls:
+    // Call ID: 4, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
+    // Call ID: 6, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 20, Callback Requested: No
+    // Call ID: 5, Type: NORMAL, Duration: 12, Callback Requested: No
+
+    // Trace Capture and Replay Test Case
+    {
+        const std::string tracePath = "telephone_queue.trace";
+        {
+            CircularQueue cq(3);
+            cq.setVerbose(false);
+            TraceWriter capture(tracePath);
+            cq.attachJournal(&capture);
+
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::EMERGENCY, 5, true };
+            Call call3 = { 3, CallType::NORMAL, 15, false };
+            Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+            cq.enqueue(call1);
+            cq.enqueue(call2);
+            cq.enqueue(call3);
+            cq.prioritizeEmergencyCalls();
+            cq.dequeue();
+            cq.enqueue(call4);
+            std::cout << "Captured trace records: " << capture.recordCount() << "\n";
+        }
+
+        std::vector<TraceRecord> trace;
+        readTrace(tracePath, trace);
+        CircularQueue replayed(3);
+        ReplayReport report = replayTrace(trace, replayed);
+        std::cout << "Replayed operations: " << report.operations
+            << ", failed enqueues: " << report.enqueue.failed << "\n";
+        std::cout << "Queue after replay:\n";
+        replayed.display();  std::cout << "\n\n";
+        std::remove(tracePath.c_str());
+    }
+    // Expected Output:
+    // Captured trace records: 6
+    // Enqueued Call ID: 1
+    // Enqueued Call ID: 2
+    // Enqueued Call ID: 3
+    // Dequeued Call ID: 2
+    // Enqueued Call ID: 4
+    // Replayed operations: 6, failed enqueues: 0
+    // Queue after replay:
+    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
+    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
+
+    // Trace Replay Test Case: Records With Ops Replay Does Not Know
+    {
+        const std::string tracePath = "telephone_queue_foreign.trace";
+        TraceRecord enqueue{};
+        enqueue.op = QueueOp::ENQUEUE;
+        enqueue.type = CallType::NORMAL;
+        enqueue.callId = 1;
+        enqueue.duration = 10;
+        TraceRecord emergency = enqueue;
+        emergency.type = CallType::EMERGENCY;
+        emergency.callId = 2;
+        TraceRecord cancel{};
+        cancel.op = QueueOp::CANCEL;
+        {
+            TraceWriter writer(tracePath);
+            for (const TraceRecord& record : { enqueue, emergency, cancel }) writer.write(record);
+        }
+        std::vector<TraceRecord> trace;
+        std::cout << "Trace file with a CANCEL record accepted: " << (readTrace(tracePath, trace) ? "Yes" : "No") << "\n";
+
+        CircularQueue replayed(3);
+        replayed.setVerbose(false);
+        ReplayReport report = replayTrace(std::vector<TraceRecord>{ enqueue, emergency, cancel }, replayed);
+        std::cout << "Replayed operations: " << report.operations << ", skipped: " << report.skipped
+            << ", prioritizations: " << report.prioritize.count << ", front call: " << replayed.begin()->callId << "\n\n";
+        std::remove(tracePath.c_str());
+    }
+    // Expected Output:
+    // Trace file with a CANCEL record accepted: No
+    // Replayed operations: 2, skipped: 1, prioritizations: 0, front call: 1
+
+    // Synthetic Load Generator Test Case
+    {
+        CircularQueue cq(5);
+
+        LoadProfile profile;
+        profile.arrivals = ArrivalModel::MMPP;
+        profile.emergencyRatio = 0.3;
+        profile.durations = DurationModel::UNIFORM;
+        CallLoadGenerator generator(profile, 2024);
+
+        long long accepted = generator.feed(cq, 6); // One more call than fits
+
+        std::cout << "Generated calls accepted: " << accepted << "\n";
+        std::cout << "Queue after synthetic load:\n";
+        cq.display();  std::cout << "\n\n";
+    }
+    // Expected Output:
+    // Enqueued Call ID: 1
+    // Enqueued Call ID: 2
+    // Enqueued Call ID: 3
+    // Enqueued Call ID: 4
+    // Enqueued Call ID: 5
+    // Queue Overflow! Cannot enqueue call.
+    // Generated calls accepted: 5
+    // Queue after synthetic load:
+    // Call ID: 1, Type: NORMAL, Duration: 3, Callback Requested: Yes
+    // Call ID: 2, Type: EMERGENCY, Duration: 2, Callback Requested: Yes
+    // Call ID: 3, Type: NORMAL, Duration: 7, Callback Requested: No
+    // Call ID: 4, Type: NORMAL, Duration: 4, Callback Requested: No
+    // Call ID: 5, Type: NORMAL, Duration: 6, Callback Requested: No
+
+    // Wait Time Histograms per Call Type Test Case
+    {
+        WaitTimeRecorder recorder;
+        CircularQueue cq(5);
+        cq.setVerbose(false);
+        cq.attachWaitRecorder(&recorder);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 15, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.dequeue();
+        cq.dequeue();
+        cq.dequeue();
+
+        std::cout << "NORMAL waits recorded: " << recorder.snapshot(CallType::NORMAL).count() << "\n";
+        std::cout << "EMERGENCY waits recorded: " << recorder.snapshot(CallType::EMERGENCY).count() << "\n";
+
+        // Known wait times, in nanoseconds, recorded directly
+        recorder.intervalSnapshot(CallType::EMERGENCY);
+        for (int wait = 1; wait <= 1000; ++wait) {
+            recorder.record(CallType::EMERGENCY, wait * 1000);
+        }
+        LatencyHistogram interval = recorder.intervalSnapshot(CallType::EMERGENCY);
+        std::cout << "Interval count: " << interval.count()
+            << ", p50: " << interval.percentile(0.5)
+            << ", p90: " << interval.percentile(0.9)
+            << ", p99: " << interval.percentile(0.99)
+            << ", p99.9: " << interval.percentile(0.999)
+            << ", max: " << interval.max() << "\n";
+        std::cout << "Next interval count: " << recorder.intervalSnapshot(CallType::EMERGENCY).count() << "\n\n";
+    }
+    // Expected Output:
+    // NORMAL waits recorded: 2
+    // EMERGENCY waits recorded: 1
+    // Interval count: 1000, p50: 501759, p90: 901119, p99: 991231, p99.9: 999423, max: 1003519
+    // Next interval count: 0
+
+    // Per-Thread Slots Test Case: Short-Lived Owners Do Not Grow a Thread's Cache
     {
-        CircularQueue cq(4);
+        PerThreadSlots<long long> longLived;
+        longLived.local() = 1;
+        for (int round = 0; round < 10000; ++round) {
+            PerThreadSlots<long long> shortLived;
+            shortLived.local() += round;
+        }
+        long long total = 0;
+        longLived.forEach([&](long long value) { total += value; });
+        std::cout << "Owners cached by this thread: " << PerThreadSlots<long long>::cachedOwners()
+            << ", Long-lived value: " << total << "\n\n";
+    }
+    // Expected Output:
+    // Owners cached by this thread: 2, Long-lived value: 1
+
+    // Queue Health Metrics Test Case
+    {
+        QueueMetrics metrics("main");
+        CircularQueue cq(3);
+        cq.setVerbose(false);
 
         Call call1 = { 1, CallType::NORMAL, 10, false };
         Call call2 = { 2, CallType::EMERGENCY, 5, true };
@@ -2815,179 +9403,809 @@ int main() {
         Call call4 = { 4, CallType::EMERGENCY, 8, true };
 
         cq.enqueue(call1);
+        cq.attachMetrics(&metrics); // Call 1 was already waiting
         cq.enqueue(call2);
         cq.enqueue(call3);
-        cq.enqueue(call4);
-
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
-
+        cq.enqueue(call4); // This should trigger Queue Overflow
         cq.prioritizeEmergencyCalls();
-
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
-
         cq.dequeue();
+        cq.cancel(3);
         cq.dequeue();
+        cq.dequeue(); // This should trigger Queue Underflow
 
-        std::cout << "Queue after two dequeues:\n";
-        cq.display();  std::cout << "\n\n";
-
-
+        std::cout << metrics.prometheusText() << "\n";
     }
     // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Queue after prioritizing emergency calls:
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Dequeued Call ID: 2
-    // Dequeued Call ID: 4
-    // Queue after two dequeues:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-
-    // Edge Case Test Case 2
+    // # HELP telephone_queue_enqueues_total Calls accepted into the queue.
+    // # TYPE telephone_queue_enqueues_total counter
+    // telephone_queue_enqueues_total{queue="main",type="normal"} 1
+    // telephone_queue_enqueues_total{queue="main",type="emergency"} 1
+    // # HELP telephone_queue_dequeues_total Calls taken from the queue.
+    // # TYPE telephone_queue_dequeues_total counter
+    // telephone_queue_dequeues_total{queue="main",type="normal"} 1
+    // telephone_queue_dequeues_total{queue="main",type="emergency"} 1
+    // # HELP telephone_queue_overflows_total Calls rejected because the queue was full.
+    // # TYPE telephone_queue_overflows_total counter
+    // telephone_queue_overflows_total{queue="main",type="normal"} 0
+    // telephone_queue_overflows_total{queue="main",type="emergency"} 1
+    // # HELP telephone_queue_cancellations_total Calls removed before being answered.
+    // # TYPE telephone_queue_cancellations_total counter
+    // telephone_queue_cancellations_total{queue="main",type="normal"} 1
+    // telephone_queue_cancellations_total{queue="main",type="emergency"} 0
+    // # HELP telephone_queue_underflows_total Dequeues attempted on an empty queue.
+    // # TYPE telephone_queue_underflows_total counter
+    // telephone_queue_underflows_total{queue="main"} 1
+    // # HELP telephone_queue_reprioritizations_total Times emergency calls were moved to the front.
+    // # TYPE telephone_queue_reprioritizations_total counter
+    // telephone_queue_reprioritizations_total{queue="main"} 1
+    // # HELP telephone_queue_depth Calls currently waiting.
+    // # TYPE telephone_queue_depth gauge
+    // telephone_queue_depth{queue="main",type="normal"} 0
+    // telephone_queue_depth{queue="main",type="emergency"} 0
+    // # HELP telephone_queue_depth_high_water Most calls of a type that have waited at once.
+    // # TYPE telephone_queue_depth_high_water gauge
+    // telephone_queue_depth_high_water{queue="main",type="normal"} 2
+    // telephone_queue_depth_high_water{queue="main",type="emergency"} 1
+
+    // Per-Call Lifecycle Tracing Test Case
     {
-        CircularQueue cq(5);  std::cout << "\n\n";
+        CircularQueue cq(3);
+        cq.setVerbose(false);
 
         Call call1 = { 1, CallType::NORMAL, 10, false };
         Call call2 = { 2, CallType::EMERGENCY, 5, true };
         Call call3 = { 3, CallType::NORMAL, 15, false };
         Call call4 = { 4, CallType::EMERGENCY, 8, true };
-        Call call5 = { 5, CallType::NORMAL, 20, false };
 
-        cq.enqueue(call1);
+        cq.enqueue(call1); // Not traced: tracing is off
+
+        LifecycleTracer tracer;
+        tracer.start();
         cq.enqueue(call2);
         cq.enqueue(call3);
-        cq.enqueue(call4);
-        cq.enqueue(call5);
-
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
-
+        cq.enqueue(call4); // This should be rejected
         cq.prioritizeEmergencyCalls();
+        cq.dequeue();
+        cq.cancel(3);
+        tracer.stop();
+        cq.dequeue(); // Not traced
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+        for (const LifecycleEvent& event : tracer.events()) {
+            std::cout << "Call ID: " << event.callId << ", " << LifecycleTracer::stageName(event.stage)
+                << ", Position: " << event.position << "\n";
+        }
+        const std::string tracePath = "telephone_queue_trace.json";
+        std::cout << "Chrome trace exported: " << (tracer.exportChromeTrace(tracePath) ? "Yes" : "No") << "\n\n";
+        std::remove(tracePath.c_str());
+    }
+    // Expected Output:
+    // Call ID: 2, ENQUEUED, Position: 1
+    // Call ID: 3, ENQUEUED, Position: 2
+    // Call ID: 4, REJECTED, Position: -1
+    // Call ID: 2, REPRIORITIZED, Position: 0
+    // Call ID: 2, DEQUEUED, Position: 0
+    // Call ID: 3, CANCELLED, Position: 1
+    // Chrome trace exported: Yes
+
+    // Aging Scheduler Test Case: NORMAL Calls Are Not Starved
+    {
+        const std::int64_t second = 1000000000LL;
+        SchedulerPolicy strict;
+        strict.mode = DispatchMode::EMERGENCY_FIRST;
+        SchedulerPolicy aging;
+        aging.mode = DispatchMode::AGING;
+        aging.basePriority[1] = 60; // EMERGENCY calls count as having waited 60s longer
+
+        for (const SchedulerPolicy& policy : { strict, aging }) {
+            CallScheduler scheduler(5, policy);
+
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::EMERGENCY, 5, true };
+            Call call3 = { 3, CallType::EMERGENCY, 8, true };
+            Call call4 = { 4, CallType::EMERGENCY, 6, true };
+
+            scheduler.enqueue(call1, 0);
+            scheduler.enqueue(call2, 30 * second);
+            scheduler.enqueue(call3, 70 * second);
+            scheduler.enqueue(call4, 80 * second);
+
+            std::cout << (policy.mode == DispatchMode::AGING ? "Aging" : "Emergency-first") << " dispatch order at t=90s:";
+            Call call;
+            for (std::int64_t t = 90; scheduler.dequeue(call, t * second); ++t) {
+                std::cout << " " << call.callId;
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Emergency-first dispatch order at t=90s: 2 3 4 1
+    // Aging dispatch order at t=90s: 2 1 3 4
 
-        // Attempt to enqueue another call to test overflow
-        Call call6 = { 6, CallType::NORMAL, 12, false };
-        cq.enqueue(call6); // This should trigger Queue Overflow
+    // Deadline Scheduler Test Case: Earliest Deadline Served First
+    {
+        const std::int64_t second = 1000000000LL;
+        DeadlineScheduler scheduler(5); // NORMAL calls due in 300s, EMERGENCY in 30s
 
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+        Call call4 = { 4, CallType::NORMAL, 6, true };
+        call4.deadlineNs = 295 * second; // explicit deadline overrides the SLA
+
+        scheduler.enqueue(call1, 0);            // due at 300s
+        scheduler.enqueue(call2, 280 * second); // due at 310s
+        scheduler.enqueue(call3, 285 * second); // due at 585s
+        scheduler.enqueue(call4, 286 * second); // due at 295s
+
+        std::cout << "EDF dispatch order:";
+        Call call;
+        for (std::int64_t t : { 290, 299, 305, 600 }) {
+            scheduler.dequeue(call, t * second);
+            std::cout << " " << call.callId;
+        }
+        std::cout << "\nMissed deadlines: " << scheduler.missedDeadlines(CallType::NORMAL) << " NORMAL, "
+            << scheduler.missedDeadlines(CallType::EMERGENCY) << " EMERGENCY\n\n";
+    }
+    // Expected Output:
+    // EDF dispatch order: 4 1 2 3
+    // Missed deadlines: 1 NORMAL, 0 EMERGENCY
 
+    // Shortest-First Scheduler Test Case: Starvation Bound
+    {
+        const std::int64_t second = 1000000000LL;
+        for (std::int64_t bound : { ShortestFirstScheduler::kNoStarvationBound, 60 * second }) {
+            ShortestFirstScheduler scheduler(5, bound);
+
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::NORMAL, 5, true };
+            Call call3 = { 3, CallType::NORMAL, 2, false };
+            Call call4 = { 4, CallType::EMERGENCY, 8, true };
+
+            scheduler.enqueue(call1, 0);
+            scheduler.enqueue(call2, 50 * second);
+            scheduler.enqueue(call3, 55 * second);
+            scheduler.enqueue(call4, 65 * second);
+
+            std::cout << (bound == ShortestFirstScheduler::kNoStarvationBound ? "Shortest-first" : "Shortest-first, 60s bound")
+                << " dispatch order at t=70s:";
+            Call call;
+            while (scheduler.dequeue(call, 70 * second)) {
+                std::cout << " " << call.callId;
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
     }
     // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
-    // Queue after prioritizing emergency calls:
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
-    // Queue Overflow! Cannot enqueue call.
+    // Shortest-first dispatch order at t=70s: 4 3 2 1
+    // Shortest-first, 60s bound dispatch order at t=70s: 4 1 3 2
 
-    // Happy Path Test Case 2
+    // Wait Estimator Test Case
     {
-        CircularQueue cq(4);
+        CircularQueue cq(5);
+        cq.setVerbose(false);
+        WaitEstimator estimator(2); // two agents
+        cq.attachWaitEstimator(&estimator);
 
         Call call1 = { 1, CallType::NORMAL, 10, false };
         Call call2 = { 2, CallType::EMERGENCY, 5, true };
-        Call call3 = { 3, CallType::NORMAL, 15, false };
-        Call call4 = { 4, CallType::EMERGENCY, 8, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
 
         cq.enqueue(call1);
         cq.enqueue(call2);
         cq.enqueue(call3);
-        cq.enqueue(call4);
+        auto print = [&] {
+            std::cout << "Estimated wait: NORMAL " << estimator.estimatedWaitNs(CallType::NORMAL) / 1000000000LL
+                << "s, EMERGENCY " << estimator.estimatedWaitNs(CallType::EMERGENCY) / 1000000000LL << "s\n";
+        };
+        print();
+        cq.cancel(3);
+        print();
+        cq.dequeue();
+        print();
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Estimated wait: NORMAL 690s, EMERGENCY 150s
+    // Estimated wait: NORMAL 450s, EMERGENCY 150s
+    // Estimated wait: NORMAL 150s, EMERGENCY 150s
 
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
+    // Position Index Test Case: Minutes Ahead of Each Caller
+    {
+        CircularQueue cq(5);
+        cq.setVerbose(false);
+        QueuePositionIndex index;
+        cq.attachPositionIndex(&index);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::NORMAL, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+        Call call4 = { 4, CallType::EMERGENCY, 7, true };
+        Call call5 = { 5, CallType::NORMAL, 3, false };
+        Call call6 = { 6, CallType::EMERGENCY, 4, true };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(call3);
+        cq.dequeue();
+        cq.enqueue(call4);
+        cq.enqueue(call5);
+        cq.enqueue(call6); // wraps to the start of the ring
 
+        auto print = [&] {
+            for (int callId = 2; callId <= 6; ++callId) {
+                std::cout << "Call ID: " << callId << ", Rank: " << index.rankOf(callId)
+                    << ", Minutes Ahead: " << index.durationAhead(callId) << "\n";
+            }
+        };
+        print();
         cq.prioritizeEmergencyCalls();
+        std::cout << "After prioritizing:\n";
+        print();
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Call ID: 2, Rank: 0, Minutes Ahead: 0
+    // Call ID: 3, Rank: 1, Minutes Ahead: 5
+    // Call ID: 4, Rank: 2, Minutes Ahead: 13
+    // Call ID: 5, Rank: 3, Minutes Ahead: 20
+    // Call ID: 6, Rank: 4, Minutes Ahead: 23
+    // After prioritizing:
+    // Call ID: 2, Rank: 2, Minutes Ahead: 11
+    // Call ID: 3, Rank: 3, Minutes Ahead: 16
+    // Call ID: 4, Rank: 0, Minutes Ahead: 0
+    // Call ID: 5, Rank: 4, Minutes Ahead: 24
+    // Call ID: 6, Rank: 1, Minutes Ahead: 7
+
+    // Async Queue Test Case: Coroutines Suspend Instead of Overflowing
+    {
+        CircularQueue cq(2);
+        cq.setVerbose(false);
+        EventLoop loop;
+        AsyncCallQueue calls(cq, loop);
+        long long callIdSum = 0;
+
+        loop.spawn(answerCalls(calls, 4, true, callIdSum)); // waits on the empty queue
+        loop.spawn(produceCalls(calls, 1, 4, true));        // suspends on the fourth call
+        loop.run();
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Producer enqueued Call ID: 1
+    // Producer enqueued Call ID: 2
+    // Producer enqueued Call ID: 3
+    // Consumer answered Call ID: 1
+    // Consumer answered Call ID: 2
+    // Consumer answered Call ID: 3
+    // Consumer answered Call ID: 4
+    // Producer enqueued Call ID: 4
+
+    // Admission Control Test Case: Shedding NORMAL Calls for an EMERGENCY Call
+    {
+        AdmissionPolicy reserve;
+        reserve.mode = ShedPolicy::REJECT_NORMAL;
+        reserve.emergencyReserve = 1;
+        AdmissionPolicy evictOldest;
+        evictOldest.mode = ShedPolicy::EVICT_OLDEST_NORMAL;
+        AdmissionPolicy evictNewest;
+        evictNewest.mode = ShedPolicy::EVICT_NEWEST_NORMAL;
+
+        for (const AdmissionPolicy& policy : { reserve, evictOldest, evictNewest }) {
+            AdmissionController controller(3, policy);
+
+            Call call1 = { 1, CallType::NORMAL, 10, false };
+            Call call2 = { 2, CallType::NORMAL, 5, true };
+            Call call3 = { 3, CallType::NORMAL, 8, false };
+            Call call4 = { 4, CallType::EMERGENCY, 7, true };
+            Call call5 = { 5, CallType::EMERGENCY, 4, true };
+
+            for (const Call& call : { call1, call2, call3, call4 }) {
+                AdmissionResult result = controller.offer(call);
+                std::cout << "Call ID: " << call.callId << ", " << admissionOutcomeName(result.outcome);
+                if (result.evicted) std::cout << " (evicted Call ID: " << result.evictedCall.callId << ")";
+                std::cout << "\n";
+            }
+            if (policy.mode == ShedPolicy::EVICT_NEWEST_NORMAL) {
+                controller.offer(call5);
+                std::cout << "Offered Call ID: 5\n";
+            }
+            std::cout << "Answer order:";
+            Call call;
+            while (controller.dequeue(call)) {
+                std::cout << " " << call.callId;
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Call ID: 1, ADMITTED
+    // Call ID: 2, ADMITTED
+    // Call ID: 3, REJECTED_SHED
+    // Call ID: 4, ADMITTED
+    // Answer order: 4 1 2
+    // Call ID: 1, ADMITTED
+    // Call ID: 2, ADMITTED
+    // Call ID: 3, ADMITTED
+    // Call ID: 4, ADMITTED_AFTER_EVICTION (evicted Call ID: 1)
+    // Answer order: 4 2 3
+    // Call ID: 1, ADMITTED
+    // Call ID: 2, ADMITTED
+    // Call ID: 3, ADMITTED
+    // Call ID: 4, ADMITTED_AFTER_EVICTION (evicted Call ID: 3)
+    // Offered Call ID: 5
+    // Answer order: 4 5 1
+
+    // Repeat Caller Filter Test Case
+    {
+        const std::int64_t second = 1000000000LL;
+        RepeatCallerFilter filter(100, 60 * second);
+        auto dial = [&](std::uint64_t caller, std::int64_t t) {
+            std::cout << "Caller " << caller << " at t=" << t << "s: "
+                << (filter.admit(caller, t * second) ? "new call" : "repeat, not enqueued") << "\n";
+        };
+
+        dial(5551234, 0);
+        dial(5551234, 5);
+        dial(5559876, 10);
+        filter.forget(5551234); // answered
+        dial(5551234, 20);
+        dial(5559876, 30);
+        dial(5559876, 200);     // never forgotten, but decayed away
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Caller 5551234 at t=0s: new call
+    // Caller 5551234 at t=5s: repeat, not enqueued
+    // Caller 5559876 at t=10s: new call
+    // Caller 5551234 at t=20s: new call
+    // Caller 5559876 at t=30s: repeat, not enqueued
+    // Caller 5559876 at t=200s: new call
+
+    // Tenant Queue Manager Test Case
+    {
+        TenantQueueManager manager;
+        int small = manager.createTenant(3);  // rounded up to 8 calls
+        int large = manager.createTenant(20); // rounded up to 32 calls
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+
+        manager.enqueue(small, call1);
+        manager.enqueue(large, call2);
+        manager.enqueue(large, call3);
+        for (int tenant : { small, large }) {
+            std::cout << "Tenant " << tenant << ": Capacity: " << manager.capacityOf(tenant)
+                << ", Waiting: " << manager.size(tenant) << ", Bytes: " << manager.memoryOf(tenant) << "\n";
+        }
 
-        cq.dequeue();
-        cq.dequeue();
+        Call call;
+        manager.dequeue(large, call);
+        std::cout << "Tenant " << large << " dequeued Call ID: " << call.callId << "\n";
+        manager.destroyTenant(small);
+        std::cout << "Destroying tenant " << small << " again: " << (manager.destroyTenant(small) ? "accepted" : "rejected") << "\n";
+        std::cout << "Enqueue on destroyed tenant " << small << ": " << (manager.enqueue(small, call1) ? "accepted" : "rejected")
+            << ", on unknown tenant 7: " << (manager.enqueue(7, call1) ? "accepted" : "rejected")
+            << ", Capacity of tenant 7: " << manager.capacityOf(7) << "\n";
+        int reused = manager.createTenant(8);
+        std::cout << "New tenant id: " << reused << ", Live tenants: " << manager.tenantCount()
+            << ", Slabs: " << manager.slabCount() << "\n\n";
+    }
+    // Expected Output:
+    // Tenant 0: Capacity: 8, Waiting: 1, Bytes: 408
+    // Tenant 1: Capacity: 32, Waiting: 2, Bytes: 1560
+    // Tenant 1 dequeued Call ID: 2
+    // Destroying tenant 0 again: rejected
+    // Enqueue on destroyed tenant 0: rejected, on unknown tenant 7: rejected, Capacity of tenant 7: 0
+    // New tenant id: 0, Live tenants: 2, Slabs: 2
+
+    // Deficit Round-Robin Test Case: Service in Proportion to Weight
+    {
+        CircularQueue tenantA(5), tenantB(5), tenantC(5);
+        for (CircularQueue* queue : { &tenantA, &tenantB, &tenantC }) queue->setVerbose(false);
+        DeficitRoundRobin scheduler(10); // 10 minutes of credit per visit and unit of weight
+        int a = scheduler.addQueue(tenantA, 1);
+        int b = scheduler.addQueue(tenantB, 1);
+        int c = scheduler.addQueue(tenantC, 2);
+
+        for (int callId : { 1, 2, 3 }) scheduler.enqueue(a, Call{ callId, CallType::NORMAL, 10, false });
+        for (int callId : { 11, 12, 13, 14 }) scheduler.enqueue(b, Call{ callId, CallType::NORMAL, 5, false });
+        for (int callId : { 21, 22, 23, 24 }) scheduler.enqueue(c, Call{ callId, CallType::NORMAL, 10, false });
+
+        std::cout << "DRR dispatch order:";
+        Call call;
+        while (scheduler.dequeue(call)) {
+            std::cout << " " << call.callId;
+        }
+        std::cout << "\n\n";
+    }
+    // Expected Output:
+    // DRR dispatch order: 1 11 12 21 22 2 13 14 23 24 3
 
-        std::cout << "Queue after two dequeues:\n";
-        cq.display();  std::cout << "\n\n";
+    // NUMA Sharded Queue Test Case: Local Calls First, Stealing When Idle
+    {
+        NumaShardedQueue queue(NumaTopology::fake(2), 4);
 
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+
+        queue.enqueue(call1, 0);
+        queue.enqueue(call2, 0);
+        queue.enqueue(call3, 1);
+
+        Call call;
+        int from = 0;
+        for (int consumerNode : { 1, 1, 0 }) {
+            queue.dequeue(call, consumerNode, &from);
+            std::cout << "Node " << consumerNode << " consumer got Call ID: " << call.callId
+                << (from == consumerNode ? " (local)" : " (stolen from node " + std::to_string(from) + ")") << "\n";
+        }
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Node 1 consumer got Call ID: 3 (local)
+    // Node 1 consumer got Call ID: 1 (stolen from node 0)
+    // Node 0 consumer got Call ID: 2 (local)
 
+    // NUMA Test Case: Invalid Fake Topologies and High Node Numbers
+    {
+        NumaTopology none = NumaTopology::fake(0);
+        std::cout << "Fake topology with 0 nodes: " << (none.isFake() ? "accepted" : "rejected")
+            << ", Nodes: " << (none.nodeCount() >= 1 ? "at least 1" : "none") << "\n";
+        NodeLocalMemory far(4096, 100); // beyond one word of node mask
+        std::cout << "Memory for node 100 mapped: " << (far.data() ? "Yes" : "No") << "\n\n";
     }
     // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Queue after prioritizing emergency calls:
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Dequeued Call ID: 2
-    // Dequeued Call ID: 4
-    // Queue after two dequeues:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
+    // Fake topology with 0 nodes: rejected, Nodes: at least 1
+    // Memory for node 100 mapped: Yes
 
-    // Edge Case Test Case 2
+    // Huge Page Ring Test Case: Small Rings Stay on the Heap
     {
-        CircularQueue cq(5);  std::cout << "\n\n";
+        CircularQueue cq(4, RingBacking::TRANSPARENT_HUGE_PAGES);
+        cq.setVerbose(false);
 
         Call call1 = { 1, CallType::NORMAL, 10, false };
         Call call2 = { 2, CallType::EMERGENCY, 5, true };
-        Call call3 = { 3, CallType::NORMAL, 15, false };
-        Call call4 = { 4, CallType::EMERGENCY, 8, true };
-        Call call5 = { 5, CallType::NORMAL, 20, false };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.dequeue();
+        cq.enqueue(call3);
+        cq.enqueue(call1); // wraps
+        std::cout << "Ring backing: " << ringBackingName(cq.ringBacking()) << "\nPositions:";
+        for (int position = 0; position < cq.size(); ++position) {
+            std::cout << " " << cq.at(position).callId;
+        }
+        std::cout << "\n\n";
+    }
+    // Expected Output:
+    // Ring backing: small_pages
+    // Positions: 2 3 1
+
+    // Ring Iterator Test Case: Standard Algorithms Across the Wraparound
+    {
+        CircularQueue cq(4);
+        cq.setVerbose(false);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+        Call call4 = { 4, CallType::EMERGENCY, 12, false };
 
         cq.enqueue(call1);
         cq.enqueue(call2);
+        cq.dequeue();
         cq.enqueue(call3);
         cq.enqueue(call4);
-        cq.enqueue(call5);
+        cq.enqueue(call1); // wraps
+
+        auto isEmergency = [](const Call& c) { return c.type == CallType::EMERGENCY; };
+        long long totalDuration = std::accumulate(cq.begin(), cq.end(), 0LL,
+            [](long long total, const Call& c) { return total + c.duration; });
+        auto longest = std::ranges::max_element(cq.calls(), {}, &Call::duration);
+        std::cout << "Emergency calls: " << std::count_if(cq.begin(), cq.end(), isEmergency)
+            << "\nTotal duration: " << totalDuration
+            << "\nLongest call: " << longest->callId << " (position " << (longest - cq.begin()) << ")"
+            << "\nThird in line: " << cq.begin()[2].callId
+            << "\nCallbacks requested:";
+        for (const Call& c : cq.calls() | std::views::filter([](const Call& c) { return c.callbackRequested; })) {
+            std::cout << " " << c.callId;
+        }
+        std::cout << "\nBack to front:";
+        for (const Call& c : cq.calls() | std::views::reverse) {
+            std::cout << " " << c.callId;
+        }
+        std::cout << "\n\n";
+    }
+    // Expected Output:
+    // Emergency calls: 2
+    // Total duration: 35
+    // Longest call: 4 (position 2)
+    // Third in line: 4
+    // Callbacks requested: 2
+    // Back to front: 1 4 3 2
+
+    // Parallel Prioritize Test Case: Same Order as the Serial Version Across the Wraparound
+    {
+        CircularQueue serial(8);
+        CircularQueue parallel(8);
+        serial.setVerbose(false);
+        parallel.setVerbose(false);
+
+        for (CircularQueue* cq : { &serial, &parallel }) {
+            for (int id = 1; id <= 4; ++id) cq->enqueue({ id, CallType::NORMAL, 5, false });
+            for (int id = 1; id <= 4; ++id) cq->dequeue();
+            for (int id = 1; id <= 7; ++id) {
+                cq->enqueue({ id, id % 3 == 0 ? CallType::EMERGENCY : CallType::NORMAL, id, false }); // wraps at id 5
+            }
+        }
+        serial.prioritizeEmergencyCalls();
+        parallel.prioritizeEmergencyCalls(3, 1); // three chunks, even for seven calls
+
+        std::cout << "Serial order:  ";
+        for (const Call& call : serial) std::cout << " " << call.callId;
+        std::cout << "\nParallel order:";
+        for (const Call& call : parallel) std::cout << " " << call.callId;
+
+        parallel.releasePrioritizeBuffer();
+        parallel.dequeue();
+        parallel.enqueue({ 8, CallType::EMERGENCY, 8, false });
+        parallel.prioritizeEmergencyCalls(3, 1); // allocates the second ring again
+        std::cout << "\nAfter releasing the buffer:";
+        for (const Call& call : parallel) std::cout << " " << call.callId;
+        std::cout << "\n\n";
+    }
+    // Expected Output:
+    // Serial order:   3 6 1 2 4 5 7
+    // Parallel order: 3 6 1 2 4 5 7
+    // After releasing the buffer: 6 8 1 2 4 5 7
 
-        std::cout << "Initial Queue:\n";
-        cq.display();  std::cout << "\n\n";
+    // Caller Metadata Test Case: Interned Strings, Reclaimed When the Queue Drains
+    {
+        CircularQueue cq(4);
+        cq.setVerbose(false);
 
-        cq.prioritizeEmergencyCalls();
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::EMERGENCY, 5, true };
+        Call call3 = { 3, CallType::NORMAL, 8, false };
+
+        cq.enqueue(call1, "+15551230001", "es", "ACC-1001");
+        cq.enqueue(call2, "+15551230002", "en", "");
+        cq.enqueue(call3, "+15551230001", "es", "ACC-1001"); // same caller again
+        std::cout << "Interned strings: " << cq.callerArena().stringCount() << "\n";
+
+        Call call;
+        while (cq.dequeue(call)) {
+            std::cout << "Call ID: " << call.callId << ", Caller: " << cq.callerNumber(call)
+                << ", Language: " << cq.callerLanguage(call)
+                << ", Account: " << (cq.callerAccount(call).empty() ? "none" : cq.callerAccount(call)) << "\n";
+        }
 
-        std::cout << "Queue after prioritizing emergency calls:\n";
-        cq.display();  std::cout << "\n\n";
+        cq.enqueue(call1, "+15551230003", "fr", "ACC-1003"); // the drained strings are released first
+        std::cout << "Interned strings after draining: " << cq.callerArena().stringCount() << "\n\n";
+    }
+    // Expected Output:
+    // Interned strings: 5
+    // Call ID: 1, Caller: +15551230001, Language: es, Account: ACC-1001
+    // Call ID: 2, Caller: +15551230002, Language: en, Account: none
+    // Call ID: 3, Caller: +15551230001, Language: es, Account: ACC-1001
+    // Interned strings after draining: 3
 
-        // Attempt to enqueue another call to test overflow
-        Call call6 = { 6, CallType::NORMAL, 12, false };
-        cq.enqueue(call6); // This should trigger Queue Overflow
+    // Caller Metadata Test Case: Stale Handles, Calls From Another Queue, and a Queue That Never Drains
+    {
+        CircularQueue home(4);
+        CircularQueue other(4);
+        home.setVerbose(false);
+        other.setVerbose(false);
+
+        Call answered;
+        home.enqueue({ 1, CallType::NORMAL, 10, false }, "+15551230001", "es", "ACC-1001");
+        home.dequeue(answered);
+        home.enqueue({ 2, CallType::NORMAL, 10, false }, "+15551230002", "en", "ACC-1002"); // releases call 1's strings
+        std::cout << "Released caller reads as: \"" << home.callerNumber(answered) << "\"\n";
+
+        Call moved;
+        home.dequeue(moved);
+        other.enqueue({ 3, CallType::NORMAL, 10, false }, "+15551230003", "fr", "ACC-1003");
+        other.enqueue(moved); // carries handles from home's arena
+        Call first;
+        other.dequeue(first);
+        std::cout << "Moved call's caller in the other queue: \"" << other.callerNumber(moved) << "\"\n";
+        other.enqueue({ 4, CallType::NORMAL, 10, false }, "+15551230004", "de", "ACC-1004");
+        std::cout << "Other queue's strings once only the moved call waited: " << other.callerArena().stringCount() << "\n";
+
+        CircularQueue busy(4);
+        busy.setVerbose(false);
+        std::size_t peakBytes = 0;
+        for (int id = 1; id <= 200000; ++id) {
+            Call dropped;
+            if (busy.size() == 3) busy.dequeue(dropped);
+            std::string number = "+1555" + std::to_string(1000000 + id);
+            busy.enqueue({ id, CallType::NORMAL, 10, false }, number, "en", "ACC-" + std::to_string(id));
+            peakBytes = std::max(peakBytes, busy.callerArena().reservedBytes());
+        }
+        std::cout << "Never-draining queue stayed under 4 MB: " << (peakBytes < (4u << 20) ? "Yes" : "No") << "\n";
+        Call call;
+        while (busy.dequeue(call)) {
+            std::cout << "Call ID: " << call.callId << ", Caller: " << busy.callerNumber(call)
+                << ", Account: " << busy.callerAccount(call) << "\n";
+        }
+        std::cout << "\n";
+    }
+    // Expected Output:
+    // Released caller reads as: ""
+    // Moved call's caller in the other queue: ""
+    // Other queue's strings once only the moved call waited: 3
+    // Never-draining queue stayed under 4 MB: Yes
+    // Call ID: 199998, Caller: +15551199998, Account: ACC-199998
+    // Call ID: 199999, Caller: +15551199999, Account: ACC-199999
+    // Call ID: 200000, Caller: +15551200000, Account: ACC-200000
+
+    // Caller Metadata Test Case: Calls Handed Across Processes Leave Their Caller Behind
+    {
+        const std::string ringPath = "telephone_queue_callers.ring";
+        std::remove(ringPath.c_str());
+        CircularQueue home(4);
+        home.setVerbose(false);
+        PersistentCircularQueue ring(ringPath, 4);
+        ring.setVerbose(false);
+        SharedCallQueue shared("/telephone_queue_callers", 4);
+
+        Call call;
+        home.enqueue({ 1, CallType::NORMAL, 10, false }, "+15551230001", "es", "ACC-1001");
+        home.enqueue({ 2, CallType::NORMAL, 10, false }, "+15551230002", "en", "ACC-1002");
+        home.dequeue(call);
+        ring.enqueue(call); // another process would read handles from its own arena
+        home.dequeue(call);
+        shared.enqueue(call);
+
+        ring.dequeue(call);
+        std::cout << "Caller after the ring file: \"" << home.callerNumber(call) << "\"\n";
+        shared.dequeue(call);
+        std::cout << "Caller after shared memory: \"" << home.callerNumber(call) << "\"\n\n";
+        std::remove(ringPath.c_str());
+    }
+    // Expected Output:
+    // Caller after the ring file: ""
+    // Caller after shared memory: ""
 
+    // Write-Ahead Log Test Case: Idle Tail Batch and Newest-Call Removal With Repeated IDs
+    {
+        const std::string logPath = "telephone_queue_tail.wal";
+        std::remove(logPath.c_str());
+        CircularQueue cq(4);
+        cq.setVerbose(false);
+        {
+            WriteAheadLog wal(logPath, 4, 64, 1000);
+            cq.attachJournal(&wal);
+
+            Call first = { 7, CallType::NORMAL, 10, false };
+            Call second = { 7, CallType::NORMAL, 20, false }; // same id, e.g. a redial
+            Call call;
+            cq.enqueue(first);
+            cq.enqueue(second);
+            cq.removeNewest(call);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            std::cout << "Idle tail batch committed: " << (wal.flushIfDue() ? "Yes" : "No")
+                << ", Syncs: " << wal.getSyncCount() << "\n";
+            cq.attachJournal(nullptr);
+        }
 
+        CircularQueue recovered(4);
+        recovered.setVerbose(false);
+        std::cout << "Records recovered: " << WriteAheadLog::recover(logPath, recovered) << "\nRecovered:";
+        for (const Call& call : recovered) std::cout << " " << call.callId << " (" << call.duration << " min)";
+        std::cout << "\n\n";
+        std::remove(logPath.c_str());
     }
     // Expected Output:
-    // Initial Queue:
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
-    // Queue after prioritizing emergency calls:
-    // Call ID: 2, Type: EMERGENCY, Duration: 5, Callback Requested: Yes
-    // Call ID: 4, Type: EMERGENCY, Duration: 8, Callback Requested: Yes
-    // Call ID: 1, Type: NORMAL, Duration: 10, Callback Requested: No
-    // Call ID: 3, Type: NORMAL, Duration: 15, Callback Requested: No
-    // Call ID: 5, Type: NORMAL, Duration: 20, Callback Requested: No
-    // Queue Overflow! Cannot enqueue call.
+    // Idle tail batch committed: Yes, Syncs: 1
+    // Records recovered: 3
+    // Recovered: 7 (10 min)
+
+    // Write-Ahead Log Test Case: A Log That Cannot Commit
+    {
+        CircularQueue cq(4);
+        cq.setVerbose(false);
+        WriteAheadLog wal("/dev/full", 4, 1); // every write fails with ENOSPC
+        cq.attachJournal(&wal);
+
+        bool accepted = cq.enqueue({ 1, CallType::NORMAL, 10, false });
+        std::cout << "Log failed: " << (wal.failed() ? "Yes" : "No")
+            << ", Call accepted: " << (accepted ? "Yes" : "No")
+            << ", Sync: " << (wal.sync() ? "ok" : "failed")
+            << ", Checkpoint: " << (wal.checkpoint(cq) ? "ok" : "failed") << "\n\n";
+        cq.attachJournal(nullptr);
+    }
+    // Expected Output:
+    // Log failed: Yes, Call accepted: No, Sync: failed, Checkpoint: failed
+
+    // Write-Ahead Log Test Case: A Checkpoint Whose Ring Does Not Fit the Queue
+    {
+        const std::string logPath = "telephone_queue_checkpoint.wal";
+        std::remove(logPath.c_str());
+        {
+            CircularQueue cq(4);
+            cq.setVerbose(false);
+            WriteAheadLog wal(logPath, 4, 1);
+            cq.enqueue({ 1, CallType::NORMAL, 10, false });
+            cq.enqueue({ 2, CallType::EMERGENCY, 5, true });
+            wal.checkpoint(cq);
+        }
+
+        // Claim 1000 waiting calls in the snapshot and re-seal the record
+        FILE* log = std::fopen(logPath.c_str(), "r+b");
+        std::vector<char> bytes(1 << 12);
+        bytes.resize(std::fread(bytes.data(), 1, bytes.size(), log));
+        const std::size_t record = bytes.size() - (8 + 9 + 12 + 2 * sizeof(Call));
+        std::uint32_t length;
+        std::memcpy(&length, bytes.data() + record, 4);
+        std::int32_t claimed = 1000;
+        std::memcpy(bytes.data() + record + 8 + 9 + 8, &claimed, 4);
+        std::uint32_t crc = crc32(bytes.data() + record + 8, length);
+        std::memcpy(bytes.data() + record + 4, &crc, 4);
+        std::rewind(log);
+        std::fwrite(bytes.data(), 1, bytes.size(), log);
+        std::fclose(log);
+
+        CircularQueue recovered(4);
+        recovered.setVerbose(false);
+        std::cout << "Records recovered: " << WriteAheadLog::recover(logPath, recovered)
+            << ", Calls waiting: " << recovered.size() << "\n\n";
+        std::remove(logPath.c_str());
+    }
+    // Expected Output:
+    // Records recovered: 0, Calls waiting: 0
+
+    // Synthetic Load Generator Test Case: Sub-Minute Mean Durations and Invalid Profiles
+    {
+        LoadProfile profile;
+        profile.meanDuration = 0.25;
+        CallLoadGenerator generator(profile, 2024);
+
+        int shortest = std::numeric_limits<int>::max();
+        std::int64_t arrivalNs;
+        for (int i = 0; i < 1000; ++i) shortest = std::min(shortest, generator.next(arrivalNs).duration);
+
+        LoadProfile negativeRate;
+        negativeRate.callsPerSecond = -5;
+        std::cout << "Shortest generated call: " << shortest << " minute(s)\n"
+            << "Profile with a negative rate is valid: " << (negativeRate.isValid() ? "Yes" : "No") << "\n\n";
+    }
+    // Expected Output:
+    // Shortest generated call: 1 minute(s)
+    // Profile with a negative rate is valid: No
+
+    // Position Index Test Case: Repeated Call IDs
+    {
+        CircularQueue cq(4);
+        cq.setVerbose(false);
+        QueuePositionIndex index;
+        cq.attachPositionIndex(&index);
+
+        Call call1 = { 1, CallType::NORMAL, 10, false };
+        Call call2 = { 2, CallType::NORMAL, 5, true };
+        Call redial = { 1, CallType::NORMAL, 7, false }; // same id as call1
+
+        cq.enqueue(call1);
+        cq.enqueue(call2);
+        cq.enqueue(redial);
+        std::cout << "Call ID: 1, Rank: " << index.rankOf(1) << ", Minutes Ahead: " << index.durationAhead(1) << "\n";
+        cq.dequeue();
+        std::cout << "After answering the first: Rank: " << index.rankOf(1) << ", Minutes Ahead: " << index.durationAhead(1) << "\n";
+        Call removed;
+        cq.removeNewest(removed);
+        std::cout << "After removing the redial: Rank: " << index.rankOf(1) << "\n\n";
+    }
+    // Expected Output:
+    // Call ID: 1, Rank: 0, Minutes Ahead: 0
+    // After answering the first: Rank: 1, Minutes Ahead: 5
+    // After removing the redial: Rank: -1
 
     return 0;
 